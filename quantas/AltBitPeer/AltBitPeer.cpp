@@ -41,7 +41,7 @@ namespace quantas {
 			// std::cout << publicId() << " received a message" << std::endl;
 			Packet packet = popInStream();
 			interfaceId source = packet.sourceId();
-			json oldMessage = packet.getMessage();
+			json oldMessage = packet.takeMessage();
 			if (oldMessage["action"] == "ack") {
 				if (oldMessage["messageNum"] == ns) {
 					previousMessageRound = RoundManager::currentRound();
@@ -60,7 +60,11 @@ void BitcoinPeer::runProtocolStep(const std::vector<std::string>& overrideParent
         PendingTx pending = makeTransaction();
         _queue.push_back(pending);
         _knownTransactions.insert({pending.submitter, pending.id});
-        broadcast(buildTransactionMessage(pending));
+        if (_typedMessages) {
+            broadcastTyped(pending);
+        } else {
+            broadcast(buildTransactionMessage(pending));
+        }
     }
 
     if (!guardMine()) return;
@@ -86,7 +90,18 @@ void BitcoinPeer::runProtocolStep(const std::vector<std::string>& overrideParent
                                                       !overrideParents.empty());
 
 
-    broadcast(buildBlockMessage(record, record.parents, minedRound, pending));
+    if (_typedMessages) {
+        BlockMessage block;
+        block.hash = record.hash;
+        block.parents = record.parents;
+        block.miner = publicId();
+        block.roundMined = minedRound;
+        block.parasite = record.parasite;
+        block.transaction = pending;
+        broadcastTyped(std::move(block));
+    } else {
+        broadcast(buildBlockMessage(record, record.parents, minedRound, pending));
+    }
 }
 
 std::vector<std::string> BitcoinPeer::getParents(const PoW& group) const {
@@ -179,6 +194,12 @@ void BitcoinPeer::initParameters(const std::vector<Peer*>& _peers, json paramete
             attacker->faultManager.addFault(new ParasiteFault(leadThreshold, collaborators));
         }
     }
+
+    // blocks and transactions go out typed unless a fault has to rewrite them
+    const bool typedMessages = parameters.value("typedMessages", false);
+    for (auto* peerPtr : peers) {
+        peerPtr->_typedMessages = typedMessages && peerPtr->sendsTyped() && !peerPtr->faultsOnSend();
+    }
 }
 
 
@@ -401,83 +422,140 @@ void BitcoinPeer::checkInStrm() {
     PoW* group = pow();
     if (!group) return;
 
-    while (!inStreamEmpty()) {
-        Packet packet = popInStream();
-        json msg = packet.getMessage();
+    for (Packet& packet : drainInStream()) {
+        if (const PendingTx* tx = packet.as<PendingTx>()) {
+            receiveTransaction(*tx);
+            continue;
+        }
+        if (const BlockMessage* block = packet.as<BlockMessage>()) {
+            receiveBlock(*block);
+            continue;
+        }
+        // read in place: the payload may be shared with the rest of a broadcast
+        const json& msg = packet.getMessage();
         if (!msg.contains("type") || msg["type"] != "PoW") continue;
+        if (auto handler = s_messages.find(msg, "messageType")) {
+            (this->*handler)(msg);
+        }
+    }
+}
 
-        const std::string messageType = msg.value("messageType", std::string());
-        if (messageType == "transaction") {
-            // Cache the transaction locally so we can mine it later.
-            const json& txJson = msg["transaction"];
-            int txId = txJson.value("id", -1);
-            interfaceId submitter = txJson.value("submitter", msg.value("from_id", NO_PEER_ID));
-            if (txId < 0 || submitter == NO_PEER_ID) continue;
-            std::pair<interfaceId, int> key{submitter, txId};
-            if (_knownTransactions.insert(key).second) {
-                PendingTx pending;
-                pending.id = txId;
-                pending.roundSubmitted = txJson.value("roundSubmitted", -1);
-                pending.submitter = submitter;
-                _queue.push_back(pending);
-            }
-        } else if (messageType == "block") {
-            // Import the announced block so our local view stays in sync with the network.
-            const json& blkJson = msg["block"];
-            std::string hash = blkJson.value("hash", std::string());
-
-            std::vector<std::string> parents;
-            if (blkJson.contains("parents")) {
-                for (const auto& parent : blkJson["parents"]) {
-                    parents.push_back(parent.get<std::string>());
-                }
-            }
+const MessageTable<void (BitcoinPeer::*)(const json&)> BitcoinPeer::s_messages = {
+    {"transaction", &BitcoinPeer::onTransactionMessage},
+    {"block", &BitcoinPeer::onBlockMessage}
+};
+
+void BitcoinPeer::onTransactionMessage(const json& msg) {
+    const json& txJson = msg.at("transaction");
+    PendingTx tx;
+    tx.id = txJson.value("id", -1);
+    tx.roundSubmitted = txJson.value("roundSubmitted", -1);
+    tx.submitter = txJson.value("submitter", msg.value("from_id", NO_PEER_ID));
+    receiveTransaction(tx);
+}
 
-            const interfaceId miner = blkJson.value("miner", NO_PEER_ID);
-            const int minedRound = blkJson.value("roundMined", static_cast<int>(RoundManager::currentRound()));
-            if (hash.empty()) {
-                hash = std::to_string(miner) + ":" + parents.front();
-            }
+void BitcoinPeer::onBlockMessage(const json& msg) {
+    const json& blkJson = msg.at("block");
+    BlockMessage block;
+    block.hash = blkJson.value("hash", std::string());
+    if (blkJson.contains("parents")) {
+        for (const auto& parent : blkJson["parents"]) {
+            block.parents.push_back(parent.get<std::string>());
+        }
+    }
+    block.miner = blkJson.value("miner", NO_PEER_ID);
+    block.roundMined = blkJson.value("roundMined", static_cast<int>(RoundManager::currentRound()));
+    block.parasite = blkJson.value("parasite", false);
+    // we shouldn't do this like this.
+    if (blkJson.contains("transaction")) {
+        const json& txJson = blkJson["transaction"];
+        block.transaction.id = txJson.value("id", -1);
+        block.transaction.roundSubmitted = txJson.value("roundSubmitted", -1);
+        block.transaction.submitter = txJson.value("submitter", block.miner);
+    }
+    receiveBlock(block);
+}
 
-            // Log the block metadata exactly as advertised; parasite flags are passed through for visibility only.
-            group->registerBlock(hash,
-                                 parents,
-                                 miner,
-                                 static_cast<int>(RoundManager::currentRound()),
-                                 minedRound,
-                                 blkJson.value("parasite", false));
-            // we shouldn't do this like this.
-            if (blkJson.contains("transaction")) {
-                const json& txJson = blkJson["transaction"];
-                int txId = txJson.value("id", -1);
-                interfaceId submitter = txJson.value("submitter", blkJson.value("miner", NO_PEER_ID));
-                if (txId >= 0 && submitter != NO_PEER_ID) {
-                    std::pair<interfaceId, int> key{submitter, txId};
-                    _knownTransactions.insert(key);
-                    for (auto itTx = _queue.begin(); itTx != _queue.end(); ++itTx) {
-                        if (itTx->id == txId && itTx->submitter == submitter) {
-                            _queue.erase(itTx);
-                            break;
-                        }
-                    }
-                }
+// Cache the transaction locally so we can mine it later.
+void BitcoinPeer::receiveTransaction(const PendingTx& tx) {
+    if (tx.id < 0 || tx.submitter == NO_PEER_ID) return;
+    std::pair<interfaceId, int> key{tx.submitter, tx.id};
+    if (_knownTransactions.insert(key).second) {
+        _queue.push_back(tx);
+    }
+}
+
+// Import the announced block so our local view stays in sync with the network.
+void BitcoinPeer::receiveBlock(const BlockMessage& block) {
+    std::string hash = block.hash;
+    if (hash.empty()) {
+        hash = std::to_string(block.miner) + ":" + block.parents.front();
+    }
+
+    // Log the block metadata exactly as advertised; parasite flags are passed through for visibility only.
+    pow()->registerBlock(hash,
+                         block.parents,
+                         block.miner,
+                         static_cast<int>(RoundManager::currentRound()),
+                         block.roundMined,
+                         block.parasite);
+    const PendingTx& tx = block.transaction;
+    if (tx.id >= 0 && tx.submitter != NO_PEER_ID) {
+        std::pair<interfaceId, int> key{tx.submitter, tx.id};
+        _knownTransactions.insert(key);
+        for (auto itTx = _queue.begin(); itTx != _queue.end(); ++itTx) {
+            if (itTx->id == tx.id && itTx->submitter == tx.submitter) {
+                _queue.erase(itTx);
+                break;
             }
         }
     }
 }
 
-bool BitcoinPeer::guardSubmit() const {
-    // Simple Bernoulli trial used by the simulator to throttle transaction volume.
-    return submitRate > 0 && randMod(submitRate) == 0;
+bool BitcoinPeer::guardSubmit() {
+    // Simple Bernoulli trial (1 in submitRate per round) used by the simulator to throttle
+    // transaction volume, sampled as the geometric gap to the next submission.
+    if (submitRate <= 0) return false;
+    const size_t now = RoundManager::currentRound();
+    if (_nextSubmitRound == NO_ROUND) {
+        _nextSubmitRound = now + geometricInt(1.0 / submitRate);
+    }
+    if (_nextSubmitRound > now) return false;
+    _nextSubmitRound = now + 1 + geometricInt(1.0 / submitRate);
+    return true;
 }
 
 
-bool BitcoinPeer::guardMine() const {
+bool BitcoinPeer::guardMine() {
     if (_mineRate <= 0) return false;
     if (_mineDenominator <= 0) return false;
-    if (_queue.empty()) return false;
+    // Rounds with an empty queue are not mining attempts; the next success is drawn once
+    // there is something to mine again.
+    if (_queue.empty()) {
+        _nextMineRound = NO_ROUND;
+        return false;
+    }
     // Mining success probability is _mineRate / _mineDenominator as described in the spec.
-    return randMod(_mineDenominator) < _mineRate;
+    const size_t now = RoundManager::currentRound();
+    if (_nextMineRound == NO_ROUND) {
+        _nextMineRound = now + geometricInt(static_cast<double>(_mineRate) / _mineDenominator);
+    }
+    if (_nextMineRound > now) return false;
+    _nextMineRound = NO_ROUND;
+    return true;
+}
+
+size_t BitcoinPeer::nextWakeRound() {
+    if (!pow()) return NO_ROUND;
+    const size_t nextRound = RoundManager::currentRound() + 1;
+    size_t wake = NO_ROUND;
+    if (submitRate > 0) {
+        wake = (_nextSubmitRound == NO_ROUND) ? nextRound : _nextSubmitRound;
+    }
+    if (_mineRate > 0 && _mineDenominator > 0 && !_queue.empty()) {
+        wake = std::min(wake, (_nextMineRound == NO_ROUND) ? nextRound : _nextMineRound);
+    }
+    return wake;
 }
 
 BitcoinPeer::PendingTx BitcoinPeer::makeTransaction() {
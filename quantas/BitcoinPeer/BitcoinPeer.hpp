@@ -21,6 +21,7 @@ QUANTAS. If not, see <https://www.gnu.org/licenses/>.
 #include <utility>
 #include <vector>
 
+#include "../Common/MessageTypes.hpp"
 #include "../Common/PowPeer.hpp"
 
 namespace quantas {
@@ -37,6 +38,9 @@ public:
     void runProtocolStep(const std::vector<std::string>& overrideParents = {}) override;
     void initParameters(const std::vector<Peer*>& peers, json parameters) override;
     void endOfRound(std::vector<Peer*>& peers) override;
+    size_t nextWakeRound() override;
+    // endOfRound only logs in the last round, which always runs
+    bool endOfRoundWhenIdle() const override { return false; }
 
 private:
     // Minimal description of a queued transaction
@@ -46,9 +50,25 @@ private:
         interfaceId submitter = NO_PEER_ID;
     };
 
+    // a mined block as a typed message (transactions travel typed as a PendingTx)
+    struct BlockMessage {
+        std::string hash;
+        std::vector<std::string> parents;
+        interfaceId miner = NO_PEER_ID;
+        int roundMined = -1;
+        bool parasite = false;
+        PendingTx transaction;
+    };
+
     void checkInStrm();
-    bool guardSubmit() const;
-    bool guardMine() const;
+    // the json messages, by "messageType"
+    static const MessageTable<void (BitcoinPeer::*)(const json&)> s_messages;
+    void onTransactionMessage(const json& msg);
+    void onBlockMessage(const json& msg);
+    void receiveTransaction(const PendingTx& tx);
+    void receiveBlock(const BlockMessage& block);
+    bool guardSubmit();
+    bool guardMine();
     std::vector<std::string> getParents(const PoW& group) const;
     PendingTx makeTransaction();
     // turns contents into a sendable json format
@@ -66,6 +86,11 @@ private:
     std::set<std::pair<interfaceId, int>> _knownTransactions; // all known transactions (kept to ensure consistency with the pending queue)
     int _localSubmitted = 0; // transaction id counter
     int minedBlocks = 0; // total blocks mined by this peer
+    // Submitting and mining are Bernoulli trials each round; instead of flipping a coin every
+    // round we draw the round of the next success so idle rounds can be fast-forwarded.
+    size_t _nextSubmitRound = NO_ROUND; // NO_ROUND until drawn on the first computation
+    size_t _nextMineRound = NO_ROUND; // NO_ROUND until drawn on a computation with a non-empty queue
+    bool _typedMessages = false; // send blocks and transactions typed ("typedMessages")
 };
 
 }
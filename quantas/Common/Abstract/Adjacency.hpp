@@ -0,0 +1,90 @@
+/**
+ * The network's topology in compressed sparse row form: the neighbors of node i
+ * are _targets[_offsets[i] .. _offsets[i + 1]), sorted and without duplicates.
+ * Peers read their row through a NeighborView instead of each keeping a std::set.
+ *
+ * build() takes a function that lists the directed edges by calling link(from, to).
+ * It is called twice, once to count each node's degree and once to place the edges,
+ * so topologies go straight into the final arrays without an intermediate edge list.
+ */
+
+#ifndef ADJACENCY_HPP
+#define ADJACENCY_HPP
+
+#include <vector>
+#include <algorithm>
+#include "../NeighborView.hpp"
+
+namespace quantas {
+
+class Adjacency {
+private:
+    std::vector<size_t> _offsets{0};
+    std::vector<interfaceId> _targets;
+
+    // sort each row and drop repeated edges, then close the gaps left behind
+    void normalize() {
+        size_t write = 0;
+        for (size_t node = 0; node + 1 < _offsets.size(); ++node) {
+            auto first = _targets.begin() + _offsets[node];
+            auto last = _targets.begin() + _offsets[node + 1];
+            std::sort(first, last);
+            last = std::unique(first, last);
+            _offsets[node] = write;
+            write = std::copy(first, last, _targets.begin() + write) - _targets.begin();
+        }
+        _offsets.back() = write;
+        _targets.resize(write);
+        _targets.shrink_to_fit();
+    }
+
+public:
+    template <typename F>
+    void build(int nodes, F&& edges) {
+        nodes = std::max(nodes, 0);
+        // edges that leave the node range are ignored
+        auto valid = [nodes](long from, long to) { return from >= 0 && from < nodes && to >= 0 && to < nodes; };
+
+        std::vector<size_t> degree(nodes + 1, 0);
+        edges([&](long from, long to) {
+            if (valid(from, to)) ++degree[from + 1];
+        });
+        for (int node = 0; node < nodes; ++node) {
+            degree[node + 1] += degree[node];
+        }
+        _offsets = degree;
+        _targets.assign(_offsets.back(), NO_PEER_ID);
+        edges([&](long from, long to) {
+            if (valid(from, to)) _targets[degree[from]++] = to;
+        });
+        normalize();
+    }
+
+    // replace every entry by id(entry), keeping the rows sorted
+    template <typename F>
+    void relabel(F&& id) {
+        for (auto& target : _targets) {
+            target = id(target);
+        }
+        for (size_t node = 0; node + 1 < _offsets.size(); ++node) {
+            std::sort(_targets.begin() + _offsets[node], _targets.begin() + _offsets[node + 1]);
+        }
+    }
+
+    int nodes() const { return static_cast<int>(_offsets.size()) - 1; }
+    size_t edges() const { return _targets.size(); }
+
+    NeighborView row(int node) const {
+        const interfaceId* base = _targets.data();
+        return NeighborView(base + _offsets[node], base + _offsets[node + 1]);
+    }
+
+    void clear() {
+        _offsets.assign(1, 0);
+        _targets.clear();
+    }
+};
+
+} // namespace quantas
+
+#endif /* ADJACENCY_HPP */
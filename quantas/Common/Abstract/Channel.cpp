@@ -1,4 +1,5 @@
 #include "Channel.hpp"
+#include "Inbox.hpp"
 
  
 namespace quantas {
@@ -6,14 +7,31 @@ namespace quantas {
 Channel::Channel(interfaceId targetId, interfaceId targetInternalId,
                         interfaceId sourceId, interfaceId sourceInternalId,
                         const nlohmann::json &channelParams)
-: _targetId(targetId),
-  _targetInternalId(targetInternalId),
-  _sourceId(sourceId),
-  _sourceInternalId(sourceInternalId)
 {
+    connect(targetId, targetInternalId, sourceId, sourceInternalId, channelParams);
+}
+
+void Channel::connect(interfaceId targetId, interfaceId targetInternalId,
+                      interfaceId sourceId, interfaceId sourceInternalId,
+                      const nlohmann::json &channelParams) {
+    _targetId = targetId;
+    _targetInternalId = targetInternalId;
+    _sourceId = sourceId;
+    _sourceInternalId = sourceInternalId;
     setParameters(channelParams);
 }
 
+void Channel::connect(interfaceId targetId, interfaceId targetInternalId,
+                      interfaceId sourceId, interfaceId sourceInternalId,
+                      ChannelProperties* properties) {
+    _targetId = targetId;
+    _targetInternalId = targetInternalId;
+    _sourceId = sourceId;
+    _sourceInternalId = sourceInternalId;
+    _properties = properties;
+    resetThroughput(RoundManager::currentRound());
+}
+
 Channel::~Channel() {
     while (!_packetQueue.empty()) {
         _packetQueue.pop_front();
@@ -22,61 +40,131 @@ Channel::~Channel() {
 
 void Channel::setParameters(const nlohmann::json &params) {
     _properties = ChannelPropertiesFactory::instance().create(params);
-    _throughputLeft = _properties->getMaxMsgsRec()*(RoundManager::lastRound()-RoundManager::currentRound());
+    resetThroughput(RoundManager::currentRound());
+}
+
+void Channel::resetThroughput(ChannelLink& link, size_t fromRound) const {
+    link.throughputLeft = _properties->getMaxMsgsRec()*(RoundManager::lastRound()-fromRound);
 }
 
-int Channel::computeRandomDelay() const {
-    int delay = 1;
-    switch (_properties->getDelayStyle()) {
-    case DelayStyle::DS_UNIFORM:
-        delay = uniformInt(_properties->getMinDelay(), _properties->getMaxDelay());
-        break;
-    case DelayStyle::DS_POISSON:
-        delay = poissonInt(_properties->getAvgDelay());
-        delay = std::clamp(delay, _properties->getMinDelay(), _properties->getMaxDelay());
-        break;
-    case DelayStyle::DS_ONE:
-        delay = 1;
-        break;
+int Channel::computeRandomDelay(const ChannelLink& link) const {
+    if (link.linkDelay > 0) {
+        return _linkJitter > 0 ? link.linkDelay + uniformInt(0, _linkJitter) : link.linkDelay;
     }
-    return delay;
+    return _properties->sampleDelay();
 }
 
-void Channel::pushPacket(Packet pkt) {
+void Channel::pushPacket(Packet pkt, ChannelLink& link) {
+    RandomStream::Scope scope(link.sendStream);
     // possible drop
     if (trueWithProbability(_properties->getDropProbability())) {
         return;
     }
 
+    // an inbox locks itself, and only the source touches its link's budget
+    auto lock = _inbox != nullptr ? std::unique_lock<std::mutex>() : guard();
     bool duplicate = false;
 
     do {
         duplicate = false;
-        if (!canSend()) {
+        if (!canSend(link)) {
             return;
         }
 
-        consumeThroughput();
-        int d = computeRandomDelay();
+        consumeThroughput(link);
+        int d = computeRandomDelay(link);
         pkt.setDelay(d, d);
-        _packetQueue.push_back(pkt);
-
+        // a duplicate goes around again sharing the payload, so only the last send moves it
         duplicate = trueWithProbability(_properties->getDuplicateProbability());
-        if (duplicate) pkt.setMessage(pkt.getMessage());
-
+        const size_t arrival = pkt.arrivalRound();
+        if (_inbox != nullptr) {
+            link.inFlight.fetch_add(1, std::memory_order_relaxed);
+            _inbox->push(duplicate ? Packet(pkt) : std::move(pkt), this, &link, link.inboxOrder, link.sendSeq++);
+        } else {
+            _packetQueue.push_back(duplicate ? Packet(pkt) : std::move(pkt));
+            if (_properties->getReorderDistance() > 0 && _properties->getReorderProbability() > 0.0) {
+                overtakeInTransit();
+            }
+            _queued.store(_packetQueue.size(), std::memory_order_release);
+            if (_readyWord != nullptr) {
+                _readyWord->fetch_or(_readyBit, std::memory_order_release);
+            }
+        }
+        if (_wakeCalendar != nullptr) {
+            _wakeCalendar->schedule(arrival, _targetSlot);
+        }
     } while (duplicate);
 }
 
+void Channel::overtakeInTransit() {
+    // the packet just pushed only passes packets still in transit: the target delivers
+    // from the front up to the first of those, so with fused phases the queue ends up
+    // the same whether the target receives before or after the push
+    const size_t round = RoundManager::currentRound();
+    const auto packet = _packetQueue.end() - 1;
+    int room = 0;
+    while (room < _properties->getReorderDistance() && packet - room != _packetQueue.begin()
+           && (packet - room - 1)->arrivalRound() > round) {
+        ++room;
+    }
+    overtake(packet, room);
+}
+
 void Channel::shuffleChannel() {
+    if (_properties->getReorderDistance() > 0) return;
+    // packets are appended in send order, so those sent this round (only possible
+    // with fused phases) form the tail of the queue and must stay behind the rest
+    auto end = _packetQueue.end();
+    while (end != _packetQueue.begin() && (end - 1)->getRoundSent() >= static_cast<int>(RoundManager::currentRound())) {
+        --end;
+    }
     // reorder
-    if (_packetQueue.size() > 1 && trueWithProbability(_properties->getReorderProbability())) {
-        std::shuffle(_packetQueue.begin(), _packetQueue.end(), threadLocalEngine());
+    if (end - _packetQueue.begin() > 1 && trueWithProbability(_properties->getReorderProbability())) {
+        std::shuffle(_packetQueue.begin(), end, threadLocalEngine());
+    }
+}
+
+int Channel::deliverArrived(PacketQueue& inStream) {
+    if (_queued.load(std::memory_order_acquire) == 0) return 0;
+    auto lock = guard();
+    RandomStream::Scope scope(_link.deliverStream);
+    shuffleChannel();
+
+    // pop up to maxMsgsRec() messages that have arrived
+    int recCount = 0;
+    while (!_packetQueue.empty()
+           && _packetQueue.front().hasArrived()
+           && recCount < maxMsgsRec())
+    {
+        inStream.push_back(std::move(_packetQueue.front()));
+        _packetQueue.pop_front();
+        ++recCount;
+    }
+    _queued.store(_packetQueue.size(), std::memory_order_release);
+    clearReadyIfEmpty();
+    return recCount;
+}
+
+size_t Channel::nextArrivalRound() const {
+    if (_queued.load(std::memory_order_acquire) == 0) return NO_ROUND;
+    auto lock = guard();
+    if (_packetQueue.empty()) return NO_ROUND;
+    if (_properties->getReorderProbability() <= 0.0 || _properties->getReorderDistance() > 0) {
+        return _packetQueue.front().arrivalRound();
+    }
+    size_t earliest = NO_ROUND;
+    for (const auto& pkt : _packetQueue) {
+        earliest = std::min(earliest, pkt.arrivalRound());
     }
+    return earliest;
 }
 
 Packet Channel::popPacket() {
+    auto lock = guard();
     Packet p = std::move(_packetQueue.front());
     _packetQueue.pop_front();
+    _queued.store(_packetQueue.size(), std::memory_order_release);
+    clearReadyIfEmpty();
     return p;
 }
 
@@ -12,6 +12,8 @@
 
 #include <memory>
 #include <deque>
+#include <mutex>
+#include <atomic>
 #include <random>
 #include <algorithm>
 #include <stdexcept>
@@ -20,6 +22,8 @@
 #include "../Json.hpp"
 #include "../RandomUtil.hpp"
 #include "../Packet.hpp"
+#include "WakeCalendar.hpp"
+#include "DelayDistribution.hpp"
 
 namespace quantas {
 
@@ -28,8 +32,10 @@ using nlohmann::json;
 
 // Forward declaration
 class NetworkInterface;
+class Inbox;
 
-enum class DelayStyle { DS_UNIFORM, DS_POISSON, DS_ONE };
+// DS_TABLE: any other distribution, drawn from a precomputed table (see DelayDistribution.hpp)
+enum class DelayStyle { DS_UNIFORM, DS_POISSON, DS_ONE, DS_TABLE };
 
 class ChannelProperties {
 public:    
@@ -42,6 +48,7 @@ public:
     void setParameters(const nlohmann::json &params) {
         dropProbability = params.value("dropProbability", 0.0);
         reorderProbability = params.value("reorderProbability", 0.0);
+        reorderDistance = params.value("reorder", "shuffle") == "swap" ? std::max(1, params.value("reorderDistance", 1)) : 0;
         duplicateProbability = params.value("duplicateProbability", 0.0);
         maxMsgsRec = params.value("maxMsgsRec", 1);
         size = params.value("size", INT_MAX);
@@ -49,21 +56,61 @@ public:
         minDelay = params.value("minDelay", 1);
         maxDelay = params.value("maxDelay", 1);
         std::string t = params.value("type", "UNIFORM");
+        delayParameters = json();
         if (t == "UNIFORM")  delayStyle = DelayStyle::DS_UNIFORM;
         else if (t == "POISSON") delayStyle = DelayStyle::DS_POISSON;
         else if (t == "ONE") delayStyle = DelayStyle::DS_ONE;
+        else if (t == "EMPIRICAL") {
+            delayStyle = DelayStyle::DS_TABLE;
+            delayTable = DelayDistributions::empirical(params, minDelay, maxDelay);
+            delayParameters = params;
+        } else if (auto cdf = DelayDistributions::find(t)) {
+            delayStyle = DelayStyle::DS_TABLE;
+            if (!params.contains("maxDelay")) {
+                maxDelay = DelayDistributions::quantile(cdf, params, DelayDistributions::DefaultMaxQuantile, minDelay);
+            }
+            delayTable = DelayDistributions::tabulate(cdf, params, minDelay, maxDelay);
+            delayParameters = params;
+        }
+        if (delayStyle == DelayStyle::DS_POISSON) {
+            if (avgDelay <= 0) {
+                throw std::invalid_argument(
+                    "poissonInt: mean (lambda) must be > 0, received: " + std::to_string(avgDelay));
+            }
+            poisson = std::poisson_distribution<int>::param_type(avgDelay);
+        }
+    }
+
+    // the delay of one packet, in rounds
+    int sampleDelay() const {
+        switch (delayStyle) {
+        case DelayStyle::DS_UNIFORM:
+            return uniformInt(minDelay, maxDelay);
+        case DelayStyle::DS_POISSON: {
+            // the same draw as poissonInt, without recomputing the parameters
+            std::poisson_distribution<int> dist(poisson);
+            return std::clamp(dist(threadLocalEngine()), minDelay, maxDelay);
+        }
+        case DelayStyle::DS_TABLE:
+            return delayTable.sample();
+        case DelayStyle::DS_ONE:
+        default:
+            return 1;
+        }
     }
 
     bool operator==(const ChannelProperties& other) const {
         return dropProbability == other.dropProbability &&
                 reorderProbability == other.reorderProbability &&
+                reorderDistance == other.reorderDistance &&
                 duplicateProbability == other.duplicateProbability &&
                 maxMsgsRec == other.maxMsgsRec &&
                 size == other.size &&
                 avgDelay == other.avgDelay &&
                 minDelay == other.minDelay &&
                 maxDelay == other.maxDelay &&
-                delayStyle == other.delayStyle;
+                delayStyle == other.delayStyle &&
+                delayParameters == other.delayParameters;
     }
 
     struct Hash {
@@ -71,6 +118,7 @@ public:
             size_t h = 0;
             h ^= std::hash<double>{}(props->getDropProbability());
             h ^= std::hash<double>{}(props->getReorderProbability());
+            h ^= std::hash<int>{}(props->getReorderDistance()) << 1;
             h ^= std::hash<double>{}(props->getDuplicateProbability());
             h ^= std::hash<int>{}(props->getMaxMsgsRec());
             h ^= std::hash<int>{}(props->getSize());
@@ -82,9 +130,15 @@ public:
         }
     };
 
+    struct Equal {
+        bool operator()(const ChannelProperties* a, const ChannelProperties* b) const { return *a == *b; }
+    };
+
     // Getters
     double getDropProbability() const { return dropProbability; }
     double getReorderProbability() const { return reorderProbability; }
+    // 0 to shuffle the queue on delivery, otherwise how many packets one may overtake
+    int getReorderDistance() const { return reorderDistance; }
     double getDuplicateProbability() const { return duplicateProbability; }
     int getMaxMsgsRec() const { return maxMsgsRec; }
     int getSize() const { return size; }
@@ -93,15 +147,22 @@ public:
     int getMaxDelay() const { return maxDelay; }
     DelayStyle getDelayStyle() const { return delayStyle; }
 
+
 private: 
     double dropProbability{0.0};
     double reorderProbability{0.0};
+    int reorderDistance{0};
     double duplicateProbability{0.0};
     int maxMsgsRec{INT_MAX};
     int size{INT_MAX};
     int avgDelay{1};
     int minDelay{1};
     int maxDelay{1};
+    // precomputed samplers: POISSON's parameters, or the table of a DS_TABLE style
+    // along with the distribution it was built from
+    std::poisson_distribution<int>::param_type poisson;
+    AliasTable delayTable;
+    json delayParameters;
 };
 
 class ChannelPropertiesFactory {
@@ -111,14 +172,15 @@ public:
         return instance;
     }
 
+    // the shared properties equal to params, created on first use
     ChannelProperties *create(const json &params) {
-        ChannelProperties *newProps = new ChannelProperties(params);
-        for (auto prop : _propertiesCache) {
-            if (*prop == *newProps) {
-                delete newProps;
-                return prop;
-            }
+        ChannelProperties candidate(params);
+        std::lock_guard<std::mutex> lock(_mtx);
+        auto it = _propertiesCache.find(&candidate);
+        if (it != _propertiesCache.end()) {
+            return *it;
         }
+        ChannelProperties *newProps = new ChannelProperties(candidate);
         _propertiesCache.insert(newProps);
         return newProps;
     }
@@ -135,10 +197,39 @@ private:
     ChannelPropertiesFactory(const ChannelPropertiesFactory &) = delete;
     ChannelPropertiesFactory &operator=(const ChannelPropertiesFactory &) = delete;
 
-    std::unordered_set<ChannelProperties*, ChannelProperties::Hash> _propertiesCache;
+    std::unordered_set<ChannelProperties*, ChannelProperties::Hash, ChannelProperties::Equal> _propertiesCache;
+    std::mutex _mtx;
+};
+
+// What a channel keeps for one edge: its random streams, send budget and link delay,
+// and its packets waiting in the target's inbox. A wired Channel holds its own; with
+// implicit channels the network keeps one per edge used (see LinkTable.hpp) and the
+// senders to a peer share that peer's Channel for everything else.
+struct ChannelLink {
+    // Sending (drop, delay, duplicate) and delivery (reorder) draw from separate streams:
+    // the source and the target may use the channel at the same time with fused phases
+    RandomStream sendStream;
+    RandomStream deliverStream;
+    // with calendar delivery: the rank of the edge in the target's inbox and the send
+    // order on it (see Inbox)
+    uint64_t inboxOrder{0};
+    uint64_t sendSeq{0};
+    // throughputLeft, if you want a limited number of sends to reduce the maximum size of the channel
+    int throughputLeft{INT_MAX};
+    // with a latency model (see LinkLatency), the delay of this link replaces the
+    // properties' delay: linkDelay rounds plus up to the channel's jitter more
+    int linkDelay{0};
+    // with calendar delivery, stands in for the queue length (decremented by the target)
+    std::atomic<uint32_t> inFlight{0};
+
+    // Key the link's random streams; channel 0 of each peer is the peer's own stream
+    void setRandomStreams(uint64_t seed, uint32_t test, uint32_t targetSlot, uint32_t sourceSlot) {
+        sendStream = RandomStream(seed, test, targetSlot, 2 * sourceSlot + 1);
+        deliverStream = RandomStream(seed, test, targetSlot, 2 * sourceSlot + 2);
+    }
 };
 
-class Channel : public std::enable_shared_from_this<Channel> {
+class Channel {
 private:
     static ChannelPropertiesFactory _propertiesFactory;
 
@@ -148,19 +239,65 @@ private:
     interfaceId _sourceId{ NO_PEER_ID };
     interfaceId _sourceInternalId{ NO_PEER_ID };
 
-    ChannelProperties* _properties; // properties of this channel
-    int    _throughputLeft{INT_MAX};   // throughputLeft, if you want a limited number of sends to reduce the maximum size of the channel
+    ChannelProperties* _properties{nullptr}; // properties of this channel
+    // the state of this channel's own edge
+    ChannelLink _link;
+    // with a latency model, how many rounds a packet may take beyond its link's delay
+    int    _linkJitter{0};
 
     // These are the packets that have been "sent" by the source side
     // but not yet delivered to the target side.
-    deque<Packet> _packetQueue;
+    PacketQueue _packetQueue;
+
+    // With active scheduling, the target's slot is scheduled for each packet's arrival round
+    WakeCalendar* _wakeCalendar{nullptr};
+    int _targetSlot{-1};
+
+    // With calendar delivery packets go straight to the target's inbox instead of the queue
+    Inbox* _inbox{nullptr};
+
+    // With fused phases the source may push while the target receives in the same round
+    bool _concurrent{false};
+    mutable std::mutex _mtx;
+    // queue size published after every change, lets the target skip empty channels
+    // without locking (a packet pushed concurrently could not be delivered this round)
+    std::atomic<size_t> _queued{0};
+    // the target's ready flag for this channel (a bit of a word it shares with the
+    // target's other inbound channels), set while the queue holds packets
+    std::atomic<uint64_t>* _readyWord{nullptr};
+    uint64_t _readyBit{0};
+
+    // called with the queue locked after removing packets
+    void clearReadyIfEmpty() {
+        if (_readyWord != nullptr && _packetQueue.empty()) {
+            _readyWord->fetch_and(~_readyBit, std::memory_order_relaxed);
+        }
+    }
+
+    std::unique_lock<std::mutex> guard() const {
+        return _concurrent ? std::unique_lock<std::mutex>(_mtx) : std::unique_lock<std::mutex>();
+    }
 
     // Helpers
-    bool canSend() const { return (_throughputLeft != 0 && (_properties->getSize() > _packetQueue.size())); }
-    int computeRandomDelay() const;
-    void consumeThroughput() {
-        if (_throughputLeft > 0) {
-            _throughputLeft--;
+    bool canSend(const ChannelLink& link) const {
+        size_t queued = _inbox != nullptr ? link.inFlight.load(std::memory_order_relaxed) : _packetQueue.size();
+        // a negative size, like INT_MAX, leaves the channel unbounded
+        const int size = _properties->getSize();
+        return (link.throughputLeft != 0 && (size < 0 || static_cast<size_t>(size) > queued));
+    }
+    int computeRandomDelay(const ChannelLink& link) const;
+    // with the "swap" reorder model: with the reorder probability, packet moves ahead of
+    // 1 to room of the packets just before it (room at most reorderDistance)
+    template <typename It>
+    void overtake(It packet, int room) {
+        if (room == 0 || !trueWithProbability(_properties->getReorderProbability())) return;
+        const int ahead = room == 1 ? 1 : uniformInt(1, room);
+        std::rotate(packet - ahead, packet, packet + 1);
+    }
+    void overtakeInTransit();
+    static void consumeThroughput(ChannelLink& link) {
+        if (link.throughputLeft > 0) {
+            link.throughputLeft--;
         }
     }
 
@@ -173,19 +310,108 @@ public:
             const json &channelParams);
     ~Channel();
 
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    // Set the ends and properties of a default constructed channel (channels are
+    // allocated as one array by the network and connected in place)
+    void connect(interfaceId targetId, interfaceId targetInternalId,
+                 interfaceId sourceId, interfaceId sourceInternalId,
+                 const json &channelParams);
+
     interfaceId targetId() {return _targetId;}
     interfaceId targetInternalId() {return _targetInternalId;}
     interfaceId sourceId() {return _sourceId;}
     interfaceId sourceInternalId() {return _sourceInternalId;}
 
+    // Connect with properties already resolved by ChannelPropertiesFactory (the network
+    // resolves its distribution once rather than once per channel)
+    void connect(interfaceId targetId, interfaceId targetInternalId,
+                 interfaceId sourceId, interfaceId sourceInternalId,
+                 ChannelProperties* properties);
+
     void setParameters(const nlohmann::json &params);
 
+    // Give this link its own delay (see LinkLatency); 0 goes back to the properties' delay
+    void setLinkDelay(int delay, int jitter) {
+        _link.linkDelay = delay;
+        _linkJitter = jitter;
+    }
+
+    // Give the channel its send budget for the rounds after fromRound
+    // (channels created mid-experiment get the budget they would have had from the start)
+    void resetThroughput(size_t fromRound) { resetThroughput(_link, fromRound); }
+    void resetThroughput(ChannelLink& link, size_t fromRound) const;
+
+    // the state of the channel's own edge
+    ChannelLink& link() { return _link; }
+
+    // Register the target with the wake calendar whenever a packet is pushed
+    void setWakeCalendar(WakeCalendar* calendar, int targetSlot) {
+        _wakeCalendar = calendar;
+        _targetSlot = targetSlot;
+    }
+
+    // Lock the queue on every access (needed when pushes and receives share a phase)
+    void setConcurrent(bool concurrent) { _concurrent = concurrent; }
+
+    // Deliver through the target's inbox; the inbox delivers channels by increasing order
+    // (their rank by source id among the target's inbound channels, or the source id)
+    void setInbox(Inbox* inbox, uint64_t order) {
+        _inbox = inbox;
+        _link.inboxOrder = order;
+    }
+
+    // Called by the target's inbox: reorder packets of a link into this channel due in
+    // the same round (shuffled, or each overtaking a few before it, with the reorder
+    // probability) and account for those it delivered
+    template <typename It>
+    void reorderArrived(It first, It last, ChannelLink& link) {
+        if (last - first < 2 || _properties->getReorderProbability() <= 0.0) return;
+        RandomStream::Scope scope(link.deliverStream);
+        if (_properties->getReorderDistance() > 0) {
+            const int distance = _properties->getReorderDistance();
+            for (It packet = first + 1; packet != last; ++packet) {
+                overtake(packet, static_cast<int>(std::min<std::ptrdiff_t>(distance, packet - first)));
+            }
+        } else if (trueWithProbability(_properties->getReorderProbability())) {
+            std::shuffle(first, last, threadLocalEngine());
+        }
+    }
+    static void delivered(ChannelLink& link, size_t count) {
+        link.inFlight.fetch_sub(static_cast<uint32_t>(count), std::memory_order_relaxed);
+    }
+
+    // Flag the channel as ready in the target's word while it holds packets, so the
+    // target's receive only visits channels with something in them
+    void setReadyFlag(std::atomic<uint64_t>* word, uint64_t bit) {
+        auto lock = guard();
+        _readyWord = word;
+        _readyBit = bit;
+        if (_readyWord != nullptr && !_packetQueue.empty()) {
+            _readyWord->fetch_or(_readyBit, std::memory_order_release);
+        }
+    }
+
+    // Key the channel's random streams; channel 0 of each peer is the peer's own stream
+    void setRandomStreams(uint64_t seed, uint32_t test, uint32_t targetSlot, uint32_t sourceSlot) {
+        _link.setRandomStreams(seed, test, targetSlot, sourceSlot);
+    }
+
     // Called by the source to push a new packet into the queue
-    void pushPacket(Packet pkt);
+    void pushPacket(Packet pkt) { pushPacket(std::move(pkt), _link); }
+    // The same over one of the links sharing this channel (only with an inbox)
+    void pushPacket(Packet pkt, ChannelLink& link);
 
-    // Called by the target before removing packets from the queue
+    // Called by the target before removing packets from the queue.
+    // Packets sent in the current round are left at the back of the queue.
+    // (Does nothing with the "swap" model, which reorders as packets are pushed.)
     void shuffleChannel();
 
+    // Called by the target: reorder if needed, then move up to maxMsgsRec
+    // arrived packets from the front of the queue to inStream
+    int deliverArrived(PacketQueue& inStream);
+
     // Called by the target to remove packets from the queue
     Packet popPacket();
 
@@ -198,6 +424,10 @@ public:
         if (_packetQueue.empty()) return false;
         return _packetQueue.front().hasArrived();
     }
+
+    // Earliest round in which this channel can deliver a packet (NO_ROUND if empty).
+    // Only the front can be delivered unless the channel shuffles its queue on delivery.
+    size_t nextArrivalRound() const;
 };
 } // end namespace quantas
 
@@ -0,0 +1,197 @@
+/**
+ * Delay distributions beyond the built-in UNIFORM, POISSON and ONE. A distribution
+ * is turned into a table of the probability of each whole delay in [minDelay,
+ * maxDelay] once, when the channel properties are created, and every packet then
+ * draws its delay from an alias table: one random number and one lookup, whatever
+ * the shape of the distribution.
+ *
+ * Continuous distributions plug in by their CDF over rounds (registerDistribution);
+ * LOGNORMAL and PARETO are registered this way. EMPIRICAL builds the table from
+ * measured delays instead. Delay d gets the mass the CDF puts on (d - 0.5, d + 0.5];
+ * the tails below minDelay and above maxDelay fall on the bounds, as POISSON clamps.
+ */
+
+#ifndef DELAY_DISTRIBUTION_HPP
+#define DELAY_DISTRIBUTION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../Json.hpp"
+#include "../RandomUtil.hpp"
+
+namespace quantas {
+
+using nlohmann::json;
+
+// Draws offset + i with probability weights[i] in O(1) (Vose's alias method)
+class AliasTable {
+private:
+    int _offset = 0;
+    std::vector<double> _prob;      // chance of keeping column i
+    std::vector<uint32_t> _alias;   // taken otherwise
+
+public:
+    AliasTable() = default;
+
+    AliasTable(const std::vector<double>& weights, int offset) : _offset(offset) {
+        const size_t n = weights.size();
+        double total = 0.0;
+        for (double w : weights) total += std::max(w, 0.0);
+        if (n == 0 || !(total > 0.0)) {
+            throw std::invalid_argument("AliasTable: weights must have a positive sum");
+        }
+        _prob.assign(n, 1.0);
+        _alias.resize(n);
+        std::vector<double> scaled(n);
+        std::vector<uint32_t> small, large;
+        for (size_t i = 0; i < n; ++i) {
+            _alias[i] = static_cast<uint32_t>(i);
+            scaled[i] = std::max(weights[i], 0.0) * n / total;
+            (scaled[i] < 1.0 ? small : large).push_back(static_cast<uint32_t>(i));
+        }
+        while (!small.empty() && !large.empty()) {
+            const uint32_t s = small.back();
+            small.pop_back();
+            const uint32_t l = large.back();
+            _prob[s] = scaled[s];
+            _alias[s] = l;
+            scaled[l] -= 1.0 - scaled[s];
+            if (scaled[l] < 1.0) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // what is left is 1 up to rounding
+    }
+
+    bool empty() const { return _prob.empty(); }
+    size_t size() const { return _prob.size(); }
+
+    int sample() const {
+        const double u = uniformReal(0.0, static_cast<double>(_prob.size()));
+        const size_t column = std::min(static_cast<size_t>(u), _prob.size() - 1);
+        const size_t i = u - column < _prob[column] ? column : _alias[column];
+        return _offset + static_cast<int>(i);
+    }
+};
+
+class DelayDistributions {
+public:
+    // P(delay <= rounds) under the distribution's parameters (the distribution json)
+    typedef std::function<double(double rounds, const json& params)> Cdf;
+
+    // largest table (maxDelay - minDelay + 1) a distribution may ask for
+    static constexpr int MaxTableSize = 1 << 20;
+    // without an explicit maxDelay, delays are capped where this much mass lies below
+    static constexpr double DefaultMaxQuantile = 0.9999;
+
+    // make "type": name available to distributions; false if the name was taken
+    static bool registerDistribution(const std::string& name, Cdf cdf) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mtx);
+        return r.cdfs.emplace(name, std::move(cdf)).second;
+    }
+
+    // the CDF registered as name, empty if there is none
+    static Cdf find(const std::string& name) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mtx);
+        auto it = r.cdfs.find(name);
+        return it == r.cdfs.end() ? Cdf() : it->second;
+    }
+
+    // smallest delay from minDelay up with at least quantile of the mass at or below it
+    static int quantile(const Cdf& cdf, const json& params, double quantile, int minDelay) {
+        int delay = minDelay;
+        while (delay - minDelay < MaxTableSize - 1 && cdf(delay + 0.5, params) < quantile) ++delay;
+        return delay;
+    }
+
+    // the table of a registered distribution over [minDelay, maxDelay]
+    static AliasTable tabulate(const Cdf& cdf, const json& params, int minDelay, int maxDelay) {
+        checkRange(minDelay, maxDelay);
+        std::vector<double> weights(maxDelay - minDelay + 1);
+        double below = 0.0;
+        for (int delay = minDelay; delay <= maxDelay; ++delay) {
+            const double upTo = delay == maxDelay ? 1.0 : cdf(delay + 0.5, params);
+            weights[delay - minDelay] = std::max(upTo - below, 0.0);
+            below = std::max(below, upTo);
+        }
+        return AliasTable(weights, minDelay);
+    }
+
+    // the table of measured delays: "samples" (one delay per observation) or "cdf"
+    // ([delay, P(delay <= it)] pairs by increasing delay). Sets the bounds it covers.
+    static AliasTable empirical(const json& params, int& minDelay, int& maxDelay) {
+        std::vector<std::pair<int, double>> mass;
+        if (params.contains("samples")) {
+            for (const auto& sample : params["samples"]) {
+                mass.emplace_back(std::max(1, sample.get<int>()), 1.0);
+            }
+        } else if (params.contains("cdf")) {
+            double below = 0.0;
+            for (const auto& point : params["cdf"]) {
+                const double upTo = point.at(1).get<double>();
+                mass.emplace_back(std::max(1, point.at(0).get<int>()), upTo - below);
+                below = upTo;
+            }
+        }
+        if (mass.empty()) {
+            throw std::invalid_argument("EMPIRICAL delays need \"samples\" or \"cdf\"");
+        }
+        minDelay = maxDelay = mass.front().first;
+        for (const auto& [delay, weight] : mass) {
+            minDelay = std::min(minDelay, delay);
+            maxDelay = std::max(maxDelay, delay);
+        }
+        checkRange(minDelay, maxDelay);
+        std::vector<double> weights(maxDelay - minDelay + 1, 0.0);
+        for (const auto& [delay, weight] : mass) {
+            weights[delay - minDelay] += weight;
+        }
+        return AliasTable(weights, minDelay);
+    }
+
+private:
+    struct Registry {
+        std::mutex mtx;
+        std::unordered_map<std::string, Cdf> cdfs;
+
+        // lognormal by mu and sigma of the delay's logarithm; Pareto by shape above scale
+        Registry() {
+            cdfs["LOGNORMAL"] = [](double x, const json& p) {
+                if (x <= 0.0) return 0.0;
+                const double mu = p.value("mu", 0.0);
+                const double sigma = p.value("sigma", 1.0);
+                return 0.5 * std::erfc(-(std::log(x) - mu) / (sigma * std::sqrt(2.0)));
+            };
+            cdfs["PARETO"] = [](double x, const json& p) {
+                const double scale = p.value("scale", 1.0);
+                const double shape = p.value("shape", 2.0);
+                return x < scale ? 0.0 : 1.0 - std::pow(scale / x, shape);
+            };
+        }
+    };
+
+    static Registry& registry() {
+        static Registry r;
+        return r;
+    }
+
+    static void checkRange(int minDelay, int maxDelay) {
+        if (minDelay > maxDelay || maxDelay - minDelay >= MaxTableSize) {
+            throw std::invalid_argument("delay distribution: [minDelay, maxDelay] is empty or too wide");
+        }
+    }
+};
+
+} // namespace quantas
+
+#endif /* DELAY_DISTRIBUTION_HPP */
@@ -0,0 +1,155 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+QUANTAS is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+You should have received a copy of the GNU General Public License along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+//
+// Runs the "experiments" array of an input file. By default the experiments run one
+// after another, exactly as before. With a core budget ("cores" at the top level of the
+// input file) several experiments run at the same time, each from its own runner thread
+// with its own RoundManager and LogWriter, so every experiment still writes its own logFile.
+//
+// The budget is split between the two levels of parallelism by network size: an experiment
+// gets one peer thread per "peersPerThread" peers (never more than its threadCount), and
+// concurrent experiments fill the rest of the budget. Small networks therefore run many at
+// a time on a thread or two each, while a large one takes most of the cores for itself.
+
+#ifndef ExperimentExecutor_hpp
+#define ExperimentExecutor_hpp
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <condition_variable>
+
+#include "Simulation.hpp"
+#include "../Json.hpp"
+#include "../LogWriter.hpp"
+#include "../RoundManager.hpp"
+
+namespace quantas {
+
+	using nlohmann::json;
+
+	class ExperimentExecutor {
+	private:
+		int _cores = 1;
+		int _peersPerThread = 32;
+
+		// cores not reserved by a running experiment
+		int _available = 0;
+		// index of the next experiment allowed to start: they start in file order, each
+		// once its cores are free, whichever runner is woken first
+		size_t _started = 0;
+		std::mutex _mtx;
+		std::condition_variable _released;
+		// first error raised by an experiment, rethrown once all runners are done
+		std::exception_ptr _error;
+
+		// threads an experiment's network gets per test, by its number of peers
+		inline int peerThreads(const json& experiment) const;
+
+		inline void runConcurrently(const json& experiments);
+
+	public:
+		// reads "cores" (0 means every hardware core) and "peersPerThread" from the input file
+		inline void setParameters(const json& config);
+
+		inline void run(const json& experiments);
+	};
+
+	inline void ExperimentExecutor::setParameters(const json& config) {
+		_cores = config.value("cores", 1);
+		if (_cores <= 0) {
+			_cores = std::max(1u, std::thread::hardware_concurrency());
+		}
+		_peersPerThread = std::max(1, config.value("peersPerThread", 32));
+	}
+
+	inline void ExperimentExecutor::run(const json& experiments) {
+		if (_cores == 1 || experiments.size() <= 1) {
+			for (const json& input : experiments) {
+				Simulation sim;
+				sim.run(input);
+			}
+			return;
+		}
+		runConcurrently(experiments);
+	}
+
+	inline int ExperimentExecutor::peerThreads(const json& experiment) const {
+		int peers = std::max(1, experiment["topology"].value("initialPeers", 1));
+		int requested = experiment.value("threadCount", _cores);
+		if (requested <= 0) requested = 1;
+		int threads = (peers + _peersPerThread - 1) / _peersPerThread;
+		return std::clamp(threads, 1, std::min({requested, peers, _cores}));
+	}
+
+	inline void ExperimentExecutor::runConcurrently(const json& experiments) {
+		_available = _cores;
+		_started = 0;
+		size_t next = 0;
+		const int runnerCount = static_cast<int>(std::min<size_t>(_cores, experiments.size()));
+		std::vector<std::thread> runners;
+		for (int r = 0; r < runnerCount; ++r) {
+			runners.emplace_back([&]() {
+				while (true) {
+					json input;
+					int reserved;
+					{
+						// experiments are taken in file order, each starts once its cores are free
+						std::unique_lock<std::mutex> lock(_mtx);
+						if (next >= experiments.size()) return;
+						const size_t index = next++;
+						input = experiments[index];
+						int threads = peerThreads(input);
+						int tests = std::max(1, input.value("tests", 1));
+						int concurrentTests = std::clamp(input.value("concurrentTests", 1), 1, std::max(1, _cores / threads));
+						concurrentTests = std::min(concurrentTests, tests);
+						input["threadCount"] = threads;
+						input["concurrentTests"] = concurrentTests;
+						reserved = threads * concurrentTests;
+						_released.wait(lock, [&]() { return _started == index && _available >= reserved; });
+						_available -= reserved;
+						++_started;
+					}
+					// the next experiment may already fit
+					_released.notify_all();
+
+					RoundManager rounds;
+					LogWriter log;
+					RoundManager::bind(&rounds);
+					LogWriter::bind(&log);
+					try {
+						Simulation sim;
+						sim.run(input);
+					} catch (...) {
+						std::lock_guard<std::mutex> lock(_mtx);
+						if (!_error) _error = std::current_exception();
+					}
+					RoundManager::bind(nullptr);
+					LogWriter::bind(nullptr);
+
+					{
+						std::lock_guard<std::mutex> lock(_mtx);
+						_available += reserved;
+					}
+					_released.notify_all();
+				}
+			});
+		}
+		for (auto& runner : runners) {
+			runner.join();
+		}
+		if (_error) {
+			std::rethrow_exception(_error);
+		}
+	}
+}
+
+#endif /* ExperimentExecutor_hpp */
@@ -0,0 +1,171 @@
+/**
+ * A receiver's calendar queue, used with "delivery": "calendar" and implicit channels
+ * (see Network::createInitialChannels). Channels push each packet under its arrival
+ * round and receive() takes exactly the packets due, ordered by channel and send
+ * order; maxMsgsRec holds back the rest of a channel's packets to the next round.
+ */
+
+#ifndef INBOX_HPP
+#define INBOX_HPP
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include "Channel.hpp"
+
+namespace quantas {
+
+class Inbox {
+private:
+    struct Entry {
+        Packet packet;
+        Channel* channel;
+        ChannelLink* link;  // the edge it came over (the channel's own unless implicit)
+        uint64_t order;  // rank of the channel's source among the receiver's inbound channels
+        uint64_t seq;    // send order on the channel
+    };
+
+    // bucket r & _mask holds the packets arriving in round r, for r in
+    // [_cursor, _cursor + _mask]; _occupied has a bit per non-empty bucket
+    std::vector<std::vector<Entry>> _wheel;
+    std::vector<uint64_t> _occupied;
+    size_t _mask = 0;
+    // first round not delivered yet
+    size_t _cursor = 0;
+    // packets arriving beyond the wheel (or, if pushed late, before the cursor)
+    std::map<size_t, std::vector<Entry>> _far;
+    // arrival round of the earliest packet in the wheel or _far, NO_ROUND if none
+    size_t _earliest = NO_ROUND;
+    // arrived but not delivered yet because of maxMsgsRec, in delivery order
+    std::vector<Entry> _held;
+    // packets pushed and not delivered yet, checked without the lock
+    std::atomic<size_t> _pending{0};
+    mutable std::mutex _mtx;
+
+    // gathered each round, kept to reuse its storage
+    std::vector<Entry> _due;
+
+    // the first round from `from` on whose bucket holds packets, NO_ROUND if none
+    size_t nextOccupied(size_t from) const {
+        const size_t slots = _mask + 1;
+        for (size_t offset = 0; offset < slots;) {
+            const size_t slot = (from + offset) & _mask;
+            // the bits up to the end of the word or of the wheel
+            const size_t span = std::min<size_t>(64 - slot % 64, slots - slot);
+            uint64_t bits = _occupied[slot / 64] >> (slot % 64);
+            if (span < 64) bits &= (uint64_t(1) << span) - 1;
+            if (bits != 0) {
+                const size_t found = offset + static_cast<size_t>(__builtin_ctzll(bits));
+                return found < slots ? from + found : NO_ROUND;
+            }
+            offset += span;
+        }
+        return NO_ROUND;
+    }
+
+    void place(Entry&& entry, size_t arrival) {
+        if (arrival >= _cursor && arrival - _cursor <= _mask) {
+            const size_t slot = arrival & _mask;
+            _wheel[slot].push_back(std::move(entry));
+            _occupied[slot / 64] |= uint64_t(1) << (slot % 64);
+        } else {
+            _far[arrival].push_back(std::move(entry));
+        }
+    }
+
+    // moves the packets arriving by round into _due and moves the cursor past it
+    void takeArrived(size_t round) {
+        for (size_t r = nextOccupied(_cursor); r != NO_ROUND && r <= round; r = nextOccupied(r + 1)) {
+            const size_t slot = r & _mask;
+            std::move(_wheel[slot].begin(), _wheel[slot].end(), std::back_inserter(_due));
+            _wheel[slot].clear();
+            _occupied[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+        }
+        _cursor = std::max(_cursor, round + 1);
+        // bring in the overflow that arrived or now fits in the wheel
+        while (!_far.empty() && _far.begin()->first <= _cursor + _mask) {
+            const size_t arrival = _far.begin()->first;
+            for (Entry& entry : _far.begin()->second) {
+                if (arrival <= round) _due.push_back(std::move(entry));
+                else place(std::move(entry), arrival);
+            }
+            _far.erase(_far.begin());
+        }
+        _earliest = nextOccupied(_cursor);
+        if (_earliest == NO_ROUND && !_far.empty()) _earliest = _far.begin()->first;
+    }
+
+public:
+    // size the wheel for packets arriving up to maxDelay rounds after they are sent
+    void reset(int maxDelay) {
+        size_t slots = 4;
+        while (slots < static_cast<size_t>(std::max(maxDelay, 1)) + 2) slots <<= 1;
+        _wheel.assign(slots, {});
+        _occupied.assign((slots + 63) / 64, 0);
+        _mask = slots - 1;
+        _cursor = RoundManager::currentRound() + 1;
+        _far.clear();
+        _earliest = NO_ROUND;
+        _held.clear();
+        _pending.store(0, std::memory_order_relaxed);
+    }
+
+    // called by the channel when a packet is sent (any thread)
+    void push(Packet&& packet, Channel* channel, ChannelLink* link, uint64_t order, uint64_t seq) {
+        const size_t arrival = packet.arrivalRound();
+        std::lock_guard<std::mutex> lock(_mtx);
+        place(Entry{std::move(packet), channel, link, order, seq}, arrival);
+        _earliest = std::min(_earliest, arrival);
+        _pending.fetch_add(1, std::memory_order_release);
+    }
+
+    // called by the receiver: moves the packets due this round to inStream, touching
+    // only the buckets that hold them
+    int deliver(PacketQueue& inStream) {
+        if (_pending.load(std::memory_order_acquire) == 0) return 0;
+        const size_t round = RoundManager::currentRound();
+        std::lock_guard<std::mutex> lock(_mtx);
+        if (_held.empty() && _earliest > round) return 0;
+        _due.clear();
+        std::move(_held.begin(), _held.end(), std::back_inserter(_due));
+        _held.clear();
+        if (_earliest <= round) takeArrived(round);
+        if (_due.empty()) return 0;
+
+        std::sort(_due.begin(), _due.end(), [](const Entry& a, const Entry& b) {
+            return a.order != b.order ? a.order < b.order : a.seq < b.seq;
+        });
+        int delivered = 0;
+        for (auto first = _due.begin(); first != _due.end();) {
+            Channel* channel = first->channel;
+            ChannelLink* link = first->link;
+            auto last = std::find_if(first, _due.end(), [link](const Entry& e) { return e.link != link; });
+            channel->reorderArrived(first, last, *link);
+            auto cut = first + std::min<ptrdiff_t>(last - first, channel->maxMsgsRec());
+            for (auto it = first; it != cut; ++it) {
+                inStream.push_back(std::move(it->packet));
+            }
+            Channel::delivered(*link, static_cast<size_t>(cut - first));
+            delivered += static_cast<int>(cut - first);
+            std::move(cut, last, std::back_inserter(_held));
+            first = last;
+        }
+        _pending.fetch_sub(delivered, std::memory_order_release);
+        return delivered;
+    }
+
+    // earliest round deliver() has something to hand over (NO_ROUND if nothing is pending)
+    size_t nextArrivalRound() const {
+        if (_pending.load(std::memory_order_acquire) == 0) return NO_ROUND;
+        std::lock_guard<std::mutex> lock(_mtx);
+        return _held.empty() ? _earliest : RoundManager::currentRound();
+    }
+};
+
+} // namespace quantas
+
+#endif /* INBOX_HPP */
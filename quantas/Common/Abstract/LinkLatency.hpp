@@ -0,0 +1,180 @@
+/**
+ * Per-link delays for geo-distributed networks, read from the "latency" block of
+ * the distribution. Every peer is placed in a region or at a point, and the delay of
+ * the link from one peer to another is the latency between their regions (a
+ * region-to-region matrix) or proportional to the distance between their points.
+ * Nothing is stored per link: a peer's region or coordinates are one entry of an
+ * array indexed by public id, so the delay of any link is computed in O(1) when its
+ * channel is connected and kept in the channel as a single number.
+ *
+ * Drop, duplicate, reorder, maxMsgsRec and size still come from the distribution,
+ * whose delay type and bounds are replaced by the link's delay plus a uniform jitter.
+ */
+
+#ifndef LINK_LATENCY_HPP
+#define LINK_LATENCY_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../Json.hpp"
+#include "../Packet.hpp"
+#include "../RandomUtil.hpp"
+
+namespace quantas {
+
+using nlohmann::json;
+
+class LinkLatency {
+public:
+    enum class Kind { NONE, REGIONS, COORDINATES };
+
+    LinkLatency() = default;
+
+    // read a "latency" block for peers 0..peers-1 (a null block leaves the model empty).
+    // Random placements draw from the calling thread's stream.
+    inline void configure(const json& latency, int peers);
+
+    // true unless a latency block was configured
+    bool empty() const { return _kind == Kind::NONE; }
+    // rounds a packet from one peer takes to reach another, before jitter
+    int delay(interfaceId from, interfaceId to) const {
+        switch (_kind) {
+        case Kind::REGIONS:
+            return _matrix[static_cast<size_t>(_regionOf[from]) * _regions + _regionOf[to]];
+        case Kind::COORDINATES: {
+            const double dx = _x[from] - _x[to];
+            const double dy = _y[from] - _y[to];
+            return std::max(1, _base + static_cast<int>(std::lround(_perUnit * std::sqrt(dx * dx + dy * dy))));
+        }
+        default:
+            return 1;
+        }
+    }
+    // extra rounds drawn uniformly from [0, jitter] for every packet
+    int jitter() const { return _jitter; }
+    // bound on delay() + jitter() over all links
+    int maxDelay() const { return _maxDelay + _jitter; }
+
+private:
+    Kind _kind = Kind::NONE;
+    int _jitter = 0;
+    int _maxDelay = 1;
+
+    // regions: the region of each peer and the regions x regions matrix, row major
+    int _regions = 0;
+    std::vector<uint16_t> _regionOf;
+    std::vector<int> _matrix;
+
+    // coordinates: the point of each peer, and base + perUnit * distance rounds per link
+    std::vector<float> _x, _y;
+    int _base = 1;
+    double _perUnit = 1.0;
+
+    inline void configureRegions(const json& latency, int peers);
+    inline void configureCoordinates(const json& latency, int peers);
+};
+
+inline void LinkLatency::configure(const json& latency, int peers) {
+    *this = LinkLatency();
+    if (latency.is_null()) return;
+    _jitter = std::max(0, latency.value("jitter", 0));
+    if (latency.contains("matrix")) {
+        configureRegions(latency, peers);
+    } else if (latency.contains("coordinates")) {
+        configureCoordinates(latency, peers);
+    } else {
+        throw std::runtime_error("latency: needs a \"matrix\" or \"coordinates\"");
+    }
+}
+
+inline void LinkLatency::configureRegions(const json& latency, int peers) {
+    const json& matrix = latency["matrix"];
+    _regions = static_cast<int>(matrix.size());
+    if (_regions == 0 || _regions > UINT16_MAX) {
+        throw std::runtime_error("latency: the matrix needs between 1 and 65535 regions");
+    }
+    _matrix.resize(static_cast<size_t>(_regions) * _regions);
+    for (int from = 0; from < _regions; ++from) {
+        if (matrix[from].size() != static_cast<size_t>(_regions)) {
+            throw std::runtime_error("latency: the matrix must be square");
+        }
+        for (int to = 0; to < _regions; ++to) {
+            const int rounds = std::max(1, matrix[from][to].get<int>());
+            _matrix[static_cast<size_t>(from) * _regions + to] = rounds;
+            _maxDelay = std::max(_maxDelay, rounds);
+        }
+    }
+
+    _regionOf.resize(peers);
+    if (latency.contains("regionOf")) {
+        const json& regionOf = latency["regionOf"];
+        if (regionOf.size() != static_cast<size_t>(peers)) {
+            throw std::runtime_error("latency: regionOf needs one region per peer");
+        }
+        for (int peer = 0; peer < peers; ++peer) {
+            const int region = regionOf[peer].get<int>();
+            if (region < 0 || region >= _regions) throw std::runtime_error("latency: region out of range in regionOf");
+            _regionOf[peer] = static_cast<uint16_t>(region);
+        }
+    } else {
+        // spread the peers evenly: consecutive ids in one region, ids taking turns,
+        // or each peer in a random region
+        const std::string assignment = latency.value("assignment", "blocks");
+        for (int peer = 0; peer < peers; ++peer) {
+            int region = 0;
+            if (assignment == "blocks") {
+                region = static_cast<int>(static_cast<int64_t>(peer) * _regions / peers);
+            } else if (assignment == "roundRobin") {
+                region = peer % _regions;
+            } else if (assignment == "random") {
+                region = uniformInt(0, _regions - 1);
+            } else {
+                throw std::runtime_error("latency: unknown assignment '" + assignment + "'");
+            }
+            _regionOf[peer] = static_cast<uint16_t>(region);
+        }
+    }
+    _kind = Kind::REGIONS;
+}
+
+inline void LinkLatency::configureCoordinates(const json& latency, int peers) {
+    _base = latency.value("base", 1);
+    _perUnit = latency.value("perUnit", 1.0);
+    _x.resize(peers);
+    _y.resize(peers);
+    const json& coordinates = latency["coordinates"];
+    if (coordinates.is_string() && coordinates.get<std::string>() == "random") {
+        // uniform over a square of the given side
+        const double side = latency.value("side", 1.0);
+        for (int peer = 0; peer < peers; ++peer) {
+            _x[peer] = static_cast<float>(uniformReal(0.0, side));
+            _y[peer] = static_cast<float>(uniformReal(0.0, side));
+        }
+    } else {
+        if (coordinates.size() != static_cast<size_t>(peers)) {
+            throw std::runtime_error("latency: coordinates needs one [x, y] per peer");
+        }
+        for (int peer = 0; peer < peers; ++peer) {
+            _x[peer] = coordinates[peer].at(0).get<float>();
+            _y[peer] = coordinates[peer].at(1).get<float>();
+        }
+    }
+
+    // the farthest pair lies within the bounding box
+    if (peers > 0) {
+        const auto [minX, maxX] = std::minmax_element(_x.begin(), _x.end());
+        const auto [minY, maxY] = std::minmax_element(_y.begin(), _y.end());
+        const double dx = *maxX - *minX;
+        const double dy = *maxY - *minY;
+        _maxDelay = std::max(1, _base + static_cast<int>(std::lround(_perUnit * std::sqrt(dx * dx + dy * dy))));
+    }
+    _kind = Kind::COORDINATES;
+}
+
+} // namespace quantas
+
+#endif /* LINK_LATENCY_HPP */
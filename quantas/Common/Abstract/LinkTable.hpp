@@ -0,0 +1,96 @@
+/**
+ * The per-edge state of implicit channels ("channels": "implicit"). Instead of a
+ * Channel per directed edge, the network keeps one Channel per target, shared by
+ * everyone sending to it, and here a ChannelLink for each edge a peer has sent over,
+ * added on its first send.
+ *
+ * Each source slot has a row: an open addressing table from target slot to link, and
+ * the links themselves in chunks that double in size, so a link never moves (inboxes
+ * point to it) and a row costs little more than the links in use. Only the source's
+ * peer adds to its row, so senders on different threads need no lock.
+ */
+
+#ifndef LINK_TABLE_HPP
+#define LINK_TABLE_HPP
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "Channel.hpp"
+
+namespace quantas {
+
+class LinkTable {
+private:
+    static constexpr int EMPTY = -1;
+
+    struct Row {
+        // targets[i] is the target slot of links[i], EMPTY if unused; the size is 0 or a
+        // power of 2 and at most half of it is used
+        std::vector<int> targets;
+        std::vector<ChannelLink*> links;
+        std::vector<std::unique_ptr<ChannelLink[]>> chunks;
+        size_t used = 0;
+        // size of the last chunk and links of it not handed out yet
+        size_t chunk = 0;
+        size_t room = 0;
+    };
+
+    std::unique_ptr<Row[]> _rows;
+
+    static size_t hash(int target) { return static_cast<uint32_t>(target) * 0x9E3779B9u; }
+
+    static void insert(Row& row, int target, ChannelLink* link) {
+        const size_t mask = row.targets.size() - 1;
+        size_t i = hash(target) & mask;
+        while (row.targets[i] != EMPTY) i = (i + 1) & mask;
+        row.targets[i] = target;
+        row.links[i] = link;
+    }
+
+    static void grow(Row& row) {
+        std::vector<int> targets(std::max<size_t>(8, 2 * row.targets.size()), EMPTY);
+        std::vector<ChannelLink*> links(targets.size(), nullptr);
+        targets.swap(row.targets);
+        links.swap(row.links);
+        for (size_t i = 0; i < targets.size(); ++i) {
+            if (targets[i] != EMPTY) insert(row, targets[i], links[i]);
+        }
+    }
+
+public:
+    // one empty row per source slot
+    void reset(size_t sources) { _rows = std::make_unique<Row[]>(sources); }
+    void clear() { _rows.reset(); }
+
+    // the link from source to target, nullptr until it is added
+    ChannelLink* find(int source, int target) const {
+        const Row& row = _rows[source];
+        if (row.targets.empty()) return nullptr;
+        const size_t mask = row.targets.size() - 1;
+        for (size_t i = hash(target) & mask; row.targets[i] != EMPTY; i = (i + 1) & mask) {
+            if (row.targets[i] == target) return row.links[i];
+        }
+        return nullptr;
+    }
+
+    // a new link from source to target, which must not have one yet
+    ChannelLink& add(int source, int target) {
+        Row& row = _rows[source];
+        if (2 * (row.used + 1) > row.targets.size()) grow(row);
+        if (row.room == 0) {
+            row.chunk = std::max<size_t>(4, row.used);
+            row.chunks.push_back(std::make_unique<ChannelLink[]>(row.chunk));
+            row.room = row.chunk;
+        }
+        ChannelLink* link = &row.chunks.back()[row.chunk - row.room--];
+        insert(row, target, link);
+        ++row.used;
+        return *link;
+    }
+};
+
+} // namespace quantas
+
+#endif /* LINK_TABLE_HPP */
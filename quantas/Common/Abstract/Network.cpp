@@ -15,6 +15,12 @@ void Network::clearExisting() {
         delete p;
     }
     _peers.clear();
+    _arena.reset();
+    _channels.reset();
+    _links.clear();
+    _inboxes.reset();
+    _adjacency.clear();
+    _regular.clear();
 }
 
 // create peers based on "topology" JSON
@@ -26,17 +32,35 @@ void Network::initNetwork(json topology) {
 
     NetworkInterfaceAbstract::resetCounter();
 
+    _networkStream = RandomStream(_seed, _test, UINT32_MAX, 0);
+    RandomStream::Scope scope(_networkStream);
+
     int initialPeers = topology.value("initialPeers", 0);
     std::string peerType = topology.value("initialPeerType", "");
-    // build peers
-    for (int i = 0; i < initialPeers; i++) {
-        auto *peer = PeerRegistry::makePeer(peerType, i);
-        _peers.push_back(peer);
-    }
+    const bool randomIds = topology.value("identifiers", "") == "random";
+    if (_usePeerArena) {
+        // build peers in slot order, so the arena holds them in the order rounds run
+        // them; the ids are shuffled exactly as the peers would be below
+        std::vector<interfaceId> ids(initialPeers);
+        std::iota(ids.begin(), ids.end(), 0);
+        if (randomIds) {
+            std::shuffle(ids.begin(), ids.end(), threadLocalEngine());
+        }
+        _arena.expect(initialPeers);
+        PeerArena::Scope arena(&_arena);
+        for (interfaceId id : ids) {
+            _peers.push_back(PeerRegistry::makePeer(peerType, id));
+        }
+    } else {
+        // build peers
+        for (int i = 0; i < initialPeers; i++) {
+            auto *peer = PeerRegistry::makePeer(peerType, i);
+            _peers.push_back(peer);
+        }
 
-    if (topology.value("identifiers", "") == "random") {
-        static std::mt19937 rng(std::random_device{}());
-        std::shuffle(_peers.begin(), _peers.end(), rng);
+        if (randomIds) {
+            std::shuffle(_peers.begin(), _peers.end(), threadLocalEngine());
+        }
     }
 
     // pick the topology
@@ -63,154 +87,377 @@ void Network::initNetwork(json topology) {
     } else if (t == "userList") {
         userList(topology);
     } else {
+        _adjacency.build(initialPeers, [](auto&&) {});
         std::cerr << "Error: missing or unknown topology 'type' in JSON.\n";
     }
 
+    // the builders link slots; peers address each other by public id
+    _slotOf.assign(_peers.size(), -1);
+    bool identity = true;
+    for (int slot = 0; slot < static_cast<int>(_peers.size()); ++slot) {
+        interfaceId id = _peers[slot]->publicId();
+        if (id >= 0 && id < static_cast<interfaceId>(_slotOf.size())) _slotOf[id] = slot;
+        identity = identity && id == slot;
+    }
+    if (!identity) {
+        // computed rows are in slots, so store them before relabeling
+        if (!_regular.empty()) {
+            const RegularTopology regular = _regular;
+            _regular.clear();
+            _adjacency.build(regular.nodes(), [&regular](auto&& link) {
+                for (int node = 0; node < regular.nodes(); ++node) {
+                    for (interfaceId nbr : regular.row(node)) {
+                        link(node, nbr);
+                    }
+                }
+            });
+        }
+        _adjacency.relabel([this](interfaceId slot) { return _peers[slot]->publicId(); });
+    }
+    for (int slot = 0; slot < static_cast<int>(_peers.size()); ++slot) {
+        _peers[slot]->setNeighbors(row(slot));
+    }
+
+    _peerStreams.clear();
+    for (uint32_t slot = 0; slot < _peers.size(); ++slot) {
+        _peerStreams.emplace_back(_seed, _test, slot, 0);
+    }
+
     createInitialChannels();
+
+    _dispatch.clear();
+    _peerCost.assign(_peers.size(), 0.0);
+    if (_activeScheduling) {
+        // every peer runs in the first round
+        _calendar.reset(static_cast<int>(_peers.size()));
+        for (int i = 0; i < static_cast<int>(_peers.size()); ++i) {
+            _calendar.schedule(RoundManager::currentRound() + 1, i);
+        }
+    }
+}
+
+void Network::connectChannel(Channel& channel, int sourceSlot, int targetSlot) {
+    Peer* peer = _peers[sourceSlot];
+    Peer* targetPeer = _peers[targetSlot];
+    channel.connect(
+        /* target IDs: */ 
+        targetPeer->publicId(), 
+        targetPeer->internalId(),
+        /* outbound (the remote) IDs: */
+        peer->publicId(),
+        peer->internalId(),
+        _channelProperties
+    );
+    if (!_latency.empty()) {
+        channel.setLinkDelay(_latency.delay(peer->publicId(), targetPeer->publicId()), _latency.jitter());
+    }
+    channel.resetThroughput(_channelsRound);
+    if (_activeScheduling) {
+        channel.setWakeCalendar(&_calendar, targetSlot);
+    }
+    channel.setConcurrent(_fusedPhases);
+    channel.setRandomStreams(_seed, _test, static_cast<uint32_t>(targetSlot), static_cast<uint32_t>(sourceSlot));
+}
+
+void Network::connectLink(ChannelLink& link, int sourceSlot, int targetSlot) {
+    Peer* peer = _peers[sourceSlot];
+    Peer* targetPeer = _peers[targetSlot];
+    if (!_latency.empty()) {
+        link.linkDelay = _latency.delay(peer->publicId(), targetPeer->publicId());
+    }
+    _channels[targetSlot].resetThroughput(link, _channelsRound);
+    // ordered by source id in the target's inbox, like wired channels
+    link.inboxOrder = static_cast<uint64_t>(peer->publicId());
+    link.setRandomStreams(_seed, _test, static_cast<uint32_t>(targetSlot), static_cast<uint32_t>(sourceSlot));
 }
 
 void Network::createInitialChannels() {
-// For each peer in the network create their channels from their neighbors
-for (auto* peer : _peers) {
-    auto neighbors = peer->neighbors();
-    for (auto nbr : neighbors) {
-            auto channelPtr = std::make_shared<Channel>(
-                /* target IDs: */ 
-                _peers[nbr]->publicId(), 
-                _peers[nbr]->internalId(),
-                /* outbound (the remote) IDs: */
-                peer->publicId(),
-                peer->internalId(),
-                _distribution
-            );
-            if (auto networkInterface = dynamic_cast<NetworkInterfaceAbstract*>(_peers[nbr]->getNetworkInterface())) {
-                networkInterface->addInboundChannel(peer->publicId(), channelPtr);
+    _channelsRound = RoundManager::currentRound();
+    _channelProperties = ChannelPropertiesFactory::instance().create(_distribution);
+    _latency.configure(_distribution.value("latency", json()), static_cast<int>(_peers.size()));
+    const int maxDelay = _latency.empty() ? _channelProperties->getMaxDelay() : _latency.maxDelay();
+    const bool implicit = _distribution.value("channels", "explicit") == "implicit";
+    _inboxes.reset();
+    if (implicit || _distribution.value("delivery", "fifo") == "calendar") {
+        _inboxes = std::make_unique<Inbox[]>(_peers.size());
+        for (size_t slot = 0; slot < _peers.size(); ++slot) {
+            _inboxes[slot].reset(maxDelay);
+        }
+    }
+
+    if (implicit) {
+        // one channel per peer, delivering into its inbox; an edge only gets its link
+        // (streams, budget, delay) when a peer first sends over it
+        _channels = std::make_unique<Channel[]>(_peers.size());
+        _links.reset(_peers.size());
+        for (size_t slot = 0; slot < _peers.size(); ++slot) {
+            Peer* peer = _peers[slot];
+            Channel& channel = _channels[slot];
+            channel.connect(peer->publicId(), peer->internalId(), NO_PEER_ID, NO_PEER_ID, _channelProperties);
+            channel.setLinkDelay(0, _latency.empty() ? 0 : _latency.jitter());
+            if (_activeScheduling) {
+                channel.setWakeCalendar(&_calendar, static_cast<int>(slot));
+            }
+            channel.setConcurrent(_fusedPhases);
+            channel.setInbox(&_inboxes[slot], 0);
+        }
+        for (size_t slot = 0; slot < _peers.size(); ++slot) {
+            if (auto networkInterface = dynamic_cast<NetworkInterfaceAbstract*>(_peers[slot]->getNetworkInterface())) {
+                const int source = static_cast<int>(slot);
+                networkInterface->setImplicitChannels([this, source](interfaceId nbr, ChannelLink*& link) -> Channel* {
+                    if (nbr < 0 || nbr >= static_cast<interfaceId>(_slotOf.size()) || _slotOf[nbr] < 0) return nullptr;
+                    const int target = _slotOf[nbr];
+                    link = _links.find(source, target);
+                    if (link == nullptr) {
+                        link = &_links.add(source, target);
+                        connectLink(*link, source, target);
+                    }
+                    return &_channels[target];
+                });
+                networkInterface->setInbox(&_inboxes[slot]);
             }
-            if (auto networkInterface = dynamic_cast<NetworkInterfaceAbstract*>(peer->getNetworkInterface())) {
-                networkInterface->addOutboundChannel(_peers[nbr]->publicId(), channelPtr);
+        }
+        return;
+    }
+
+    // one channel per edge of the adjacency, so a peer's outbound channels are
+    // contiguous and in the same order as its neighbors
+    _channels = std::make_unique<Channel[]>(_regular.empty() ? _adjacency.edges() : _regular.edges());
+    std::vector<std::vector<Channel*>> inbound(_peers.size());
+    size_t edge = 0;
+    for (size_t slot = 0; slot < _peers.size(); ++slot) {
+        NeighborView neighbors = row(static_cast<int>(slot));
+        Channel* outbound = &_channels[edge];
+        for (auto nbr : neighbors) {
+            const int target = _slotOf[nbr];
+            Channel& channel = _channels[edge++];
+            connectChannel(channel, static_cast<int>(slot), target);
+            inbound[target].push_back(&channel);
+        }
+        if (auto networkInterface = dynamic_cast<NetworkInterfaceAbstract*>(_peers[slot]->getNetworkInterface())) {
+            networkInterface->setOutboundChannels(neighbors, outbound);
+        }
+    }
+    for (size_t slot = 0; slot < _peers.size(); ++slot) {
+        // peers receive from their channels in order of source id
+        std::sort(inbound[slot].begin(), inbound[slot].end(),
+                  [](Channel* a, Channel* b) { return a->sourceId() < b->sourceId(); });
+        if (auto networkInterface = dynamic_cast<NetworkInterfaceAbstract*>(_peers[slot]->getNetworkInterface())) {
+            if (_inboxes) {
+                for (size_t i = 0; i < inbound[slot].size(); ++i) {
+                    inbound[slot][i]->setInbox(&_inboxes[slot], i);
+                }
+                networkInterface->setInbox(&_inboxes[slot]);
             }
+            networkInterface->setInboundChannels(std::move(inbound[slot]));
         }
     }
 }
 
 // ------------- Topology Builders -------------
+// Regular topologies are described by a RegularTopology, which computes each row
+// from the slot (indices into _peers). userList links slots by calling
+// link(from, to); Adjacency::build runs it to fill the CSR arrays.
 
 void Network::fullyConnect(int numberOfPeers) {
-    // for each pair i<j, call addNeighbor
-    for (int i = 0; i < numberOfPeers; i++) {
-        for (int j = i + 1; j < numberOfPeers; j++) {
-            if (i != j) {
-                _peers[i]->addNeighbor(_peers[j]->internalId());
-                _peers[j]->addNeighbor(_peers[i]->internalId());
-            }
-        }
-    }
+    // every pair, both ways
+    _regular = RegularTopology::complete(numberOfPeers);
 }
 
 void Network::star(int numberOfPeers) {
     // connect all to peer[0]
-    for (int i = 1; i < numberOfPeers; i++) {
-        _peers[0]->addNeighbor(_peers[i]->internalId());
-        _peers[i]->addNeighbor(_peers[0]->internalId());
-    }
+    _regular = RegularTopology::star(numberOfPeers);
 }
 
 void Network::grid(int height, int width) {
-    // interpret peers as a 2D grid
-    // link up/down/left/right
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            int idx = i * width + j;
-            if (j + 1 < width) {
-                // link horizontally
-                _peers[idx]->addNeighbor(_peers[idx+1]->internalId());
-                _peers[idx+1]->addNeighbor(_peers[idx]->internalId());
-            }
-            if (i + 1 < height) {
-                // link vertically
-                _peers[idx]->addNeighbor(_peers[idx+width]->internalId());
-                _peers[idx+width]->addNeighbor(_peers[idx]->internalId());
-            }
-        }
-    }
+    // interpret peers as a 2D grid, linked up/down/left/right
+    _regular = RegularTopology::grid(static_cast<int>(_peers.size()), height, width);
 }
 
 void Network::torus(int height, int width) {
     // similar to grid but wrap edges
-    // ...
-    for (int i = 0; i < height; i++) {
-        for (int j = 0; j < width; j++) {
-            int idx = i * width + j;
-            // neighbor to right (wrapping)
-            int rightIdx = i * width + ((j + 1) % width);
-            _peers[idx]->addNeighbor(_peers[rightIdx]->internalId());
-            _peers[rightIdx]->addNeighbor(_peers[idx]->internalId());
-
-            // neighbor down (wrapping)
-            int downIdx = ((i + 1) % height) * width + j;
-            _peers[idx]->addNeighbor(_peers[downIdx]->internalId());
-            _peers[downIdx]->addNeighbor(_peers[idx]->internalId());
-        }
-    }
+    _regular = RegularTopology::torus(static_cast<int>(_peers.size()), height, width);
 }
 
 void Network::chain(int numberOfPeers) {
     // link each i with i+1
-    for (int i = 0; i < numberOfPeers - 1; i++) {
-        _peers[i]->addNeighbor(_peers[i+1]->internalId());
-        _peers[i+1]->addNeighbor(_peers[i]->internalId());
-    }
+    _regular = RegularTopology::chain(numberOfPeers);
 }
 
 void Network::ring(int numberOfPeers) {
-    chain(numberOfPeers);
-    // also link last back to first
-    if (numberOfPeers > 1) {
-        _peers[numberOfPeers - 1]->addNeighbor(_peers[0]->internalId());
-        _peers[0]->addNeighbor(_peers[numberOfPeers - 1]->internalId());
-    }
+    // a chain that also links last back to first
+    _regular = RegularTopology::ring(numberOfPeers);
 }
 
 void Network::unidirectionalRing(int numberOfPeers) {
-    // link i->(i+1)
-    for (int i = 0; i < numberOfPeers - 1; i++) {
-        _peers[i]->addNeighbor(_peers[i+1]->internalId());
-    }
-    // last -> first
-    if (numberOfPeers > 1) {
-        _peers[numberOfPeers - 1]->addNeighbor(_peers[0]->internalId());
-    }
+    // link i->(i+1), last -> first
+    _regular = RegularTopology::unidirectionalRing(numberOfPeers);
 }
 
 void Network::userList(json topology) {
     // "list": { "0": [1,2], "1":[0], ... }
     // for each peer i, read the adjacency
     int initialPeers = topology.value("initialPeers", 0);
-    if (!topology.contains("list")) return;
-    json lst = topology["list"];
-    for (int i = 0; i < initialPeers; i++) {
-        std::string key = std::to_string(i);
-        if (lst.contains(key)) {
-            for (auto &dest : lst[key]) {
-                _peers[i]->addNeighbor(dest);
+    json lst = topology.value("list", json::object());
+    _adjacency.build(initialPeers, [initialPeers, &lst](auto&& link) {
+        for (int i = 0; i < initialPeers; i++) {
+            std::string key = std::to_string(i);
+            if (lst.contains(key)) {
+                for (auto &dest : lst[key]) {
+                    link(i, dest.get<long>());
+                }
             }
         }
+    });
+}
+
+void Network::initParameters(json parameters, BS::thread_pool& pool) {
+    {
+        RandomStream::Scope scope(_networkStream);
+        _peers[0]->initParameters(_peers, parameters);
+    }
+    pool.parallelize_loop(static_cast<int>(_peers.size()), [this, &parameters](int a, int b) {
+        for (int i = a; i < b; ++i) {
+            RandomStream::Scope scope(_peerStreams[i]);
+            _peers[i]->initPeer(parameters);
+        }
+    }).wait();
+}
+
+void Network::endOfRound(BS::thread_pool& pool) {
+    RandomStream::Scope scope(_networkStream);
+    _peers[0]->endOfRound(_peers);
+    if (!_peers[0]->reducesMetrics()) return;
+
+    // Peers are reduced in fixed size chunks whose results are merged in chunk order,
+    // so floating point sums come out the same whatever the number of threads
+    const int CHUNK = 64;
+    const int peers = static_cast<int>(_peers.size());
+    std::vector<MetricReducer> partials((peers + CHUNK - 1) / CHUNK);
+    pool.parallelize_loop(static_cast<int>(partials.size()), [this, &partials, peers, CHUNK](int a, int b) {
+        for (int c = a; c < b; ++c) {
+            for (int i = c * CHUNK; i < std::min(peers, (c + 1) * CHUNK); ++i) {
+                RandomStream::Scope peerScope(_peerStreams[i]);
+                _peers[i]->collectMetrics(partials[c]);
+            }
+        }
+    }).wait();
+    MetricReducer metrics;
+    for (const auto& partial : partials) {
+        metrics.merge(partial);
+    }
+    _peers[0]->reportMetrics(metrics, _peers);
+}
+
+int Network::beginRound() {
+    if (_activeScheduling) {
+        _dispatch = _calendar.takeDue(RoundManager::currentRound());
+    } else if (_dispatch.size() != _peers.size()) {
+        _dispatch.resize(_peers.size());
+        for (int i = 0; i < static_cast<int>(_peers.size()); ++i) {
+            _dispatch[i] = i;
+        }
+    }
+    return static_cast<int>(_dispatch.size());
+}
+
+int Network::runRound(BS::thread_pool& pool) {
+    int dispatched = beginRound();
+    const int threads = static_cast<int>(pool.get_thread_count());
+    _scheduler.beginRound(threads);
+    if (_scheduler.costOrdering()) {
+        _scheduler.order(_dispatch, _peerCost, threads);
+    }
+
+    if (_fusedPhases) {
+        _scheduler.run(pool, dispatched, [this](int a, int b){ receiveAndCompute(a, b); });
+    } else {
+        _scheduler.run(pool, dispatched, [this](int a, int b){ receive(a, b); });
+        _scheduler.run(pool, dispatched, [this](int a, int b){ tryPerformComputation(a, b); });
+    }
+    return dispatched;
+}
+
+void Network::receivePeer(int slot) {
+    Peer* peer = _peers[slot];
+    RandomStream::Scope scope(_peerStreams[slot]);
+    if (_scheduler.costOrdering()) {
+        auto start = std::chrono::steady_clock::now();
+        peer->receive();
+        std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+        _peerCost[slot] = took.count();
+    } else {
+        peer->receive();
+    }
+    if (_activeScheduling) {
+        // packets that arrived but were held back (maxMsgsRec, a packet ahead of
+        // them still in flight) are retried next round; later arrivals were
+        // scheduled when they were pushed
+        if (peer->nextArrivalRound() <= RoundManager::currentRound()) {
+            _calendar.schedule(RoundManager::currentRound() + 1, slot);
+        }
+    }
+}
+
+void Network::computePeer(int slot) {
+    Peer* peer = _peers[slot];
+    RandomStream::Scope scope(_peerStreams[slot]);
+    if (_scheduler.costOrdering()) {
+        auto start = std::chrono::steady_clock::now();
+        peer->tryPerformComputation();
+        std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+        _peerCost[slot] += took.count();
+    } else {
+        peer->tryPerformComputation();
+    }
+    if (_activeScheduling) {
+        _calendar.schedule(wakeRound(peer), slot);
     }
 }
 
 void Network::receive(int begin, int end) {
-    end = end < (int)_peers.size() ? end : (int)_peers.size();
+    end = end < (int)_dispatch.size() ? end : (int)_dispatch.size();
     // call receive on each peer in the range
     for (int i = begin; i < end; ++i) {
-        _peers[i]->receive();
+        receivePeer(_dispatch[i]);
     }
 }
 
 void Network::tryPerformComputation(int begin, int end) {
-    end = end < (int)_peers.size() ? end : (int)_peers.size();
+    end = end < (int)_dispatch.size() ? end : (int)_dispatch.size();
     // call tryPerformComputation on each peer in the range
     for (int i = begin; i < end; ++i) {
-        _peers[i]->tryPerformComputation();
+        computePeer(_dispatch[i]);
     }
 }
-}
\ No newline at end of file
+
+void Network::receiveAndCompute(int begin, int end) {
+    end = end < (int)_dispatch.size() ? end : (int)_dispatch.size();
+    for (int i = begin; i < end; ++i) {
+        receivePeer(_dispatch[i]);
+        computePeer(_dispatch[i]);
+    }
+}
+
+size_t Network::wakeRound(Peer* peer) const {
+    const size_t nextRound = RoundManager::currentRound() + 1;
+    size_t wake = peer->nextWakeRound();
+    // messages already in the inStream are handled on the peer's next computation
+    if (!peer->inStreamEmpty()) {
+        wake = std::min(wake, peer->isCrashed() ? peer->crashRecoveryRound() : nextRound);
+    }
+    return wake == NO_ROUND ? NO_ROUND : std::max(wake, nextRound);
+}
+
+size_t Network::nextEventRound() const {
+    if (_activeScheduling) return _calendar.nextRound();
+    const size_t nextRound = RoundManager::currentRound() + 1;
+    size_t earliest = NO_ROUND;
+    for (auto* peer : _peers) {
+        earliest = std::min(earliest, wakeRound(peer));
+        earliest = std::min(earliest, peer->nextArrivalRound());
+        if (earliest <= nextRound) return nextRound;
+    }
+    return earliest;
+}
+}
@@ -25,11 +25,23 @@ along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
 #include <limits>
 #include <iostream>
 #include <algorithm>
+#include <numeric>
 #include <memory>
 #include <deque>
 #include <climits>
+#include <chrono>
+#include <mutex>
 #include "../Peer.hpp"
 #include "../Json.hpp"
+#include "../RandomUtil.hpp"
+#include "Adjacency.hpp"
+#include "RegularTopology.hpp"
+#include "LinkLatency.hpp"
+#include "Channel.hpp"
+#include "Inbox.hpp"
+#include "LinkTable.hpp"
+#include "WakeCalendar.hpp"
+#include "PeerScheduler.hpp"
 
 namespace quantas {
 
@@ -38,24 +50,98 @@ using nlohmann::json;
 class Network {
 private:
     std::vector<Peer*>  _peers;
+    // when set, initNetwork places the peers and their interfaces in _arena, which
+    // keeps its memory from one test to the next
+    bool _usePeerArena = false;
+    PeerArena _arena;
+
+    // who is connected to whom, one row per slot holding the neighbors' public ids;
+    // peers see their row as a NeighborView. Regular topologies compute the rows
+    // (_regular); others, and regular ones with shuffled ids, store them (_adjacency)
+    Adjacency _adjacency;
+    RegularTopology _regular;
+    // slot of each public id
+    std::vector<int> _slotOf;
+    // the channel of each edge of the adjacency, in the same order (with implicit
+    // channels, the channel of each slot, shared by its senders)
+    std::unique_ptr<Channel[]> _channels;
+    // with implicit channels, the state of each edge used so far
+    LinkTable _links;
+    // one calendar queue per slot when the distribution asks for "delivery": "calendar"
+    // (or for implicit channels, which always deliver through it)
+    std::unique_ptr<Inbox[]> _inboxes;
+    // round the channels were created in; implicit channels connected later get the
+    // send budget they would have had from then
+    size_t _channelsRound = 0;
 
     json _distribution;
+    // the properties every channel shares, resolved from _distribution once per test
+    ChannelProperties* _channelProperties = nullptr;
+    // per-link delays from the distribution's "latency" block (empty without one)
+    LinkLatency _latency;
+
+    // when set, a round only dispatches the peers that have a packet arriving
+    // or asked to be woken up (see WakeCalendar)
+    bool _activeScheduling = false;
+    WakeCalendar _calendar;
+    // slots (indices into _peers) dispatched in the current round
+    std::vector<int> _dispatch;
+
+    // when set, receive and computation share one phase and channels lock on access
+    bool _fusedPhases = false;
+
+    // splits each phase over the thread pool
+    PeerScheduler _scheduler;
+    // seconds each peer took in its last round (only measured for costOrdering)
+    std::vector<double> _peerCost;
+
+    // Random streams of this test (see RandomStream): one per peer slot, used while the
+    // peer runs, and one for the network itself (topology, the first peer's global work)
+    uint64_t _seed = 0;
+    uint32_t _test = 0;
+    std::vector<RandomStream> _peerStreams;
+    RandomStream _networkStream;
+
+    // Select the peers dispatched this round and return how many there are.
+    // Ranges passed to receive and tryPerformComputation index this selection.
+    int beginRound();
+
+    void receivePeer(int slot);
+    void computePeer(int slot);
+
+    // round a peer next needs to be dispatched in, ignoring packets still in its channels
+    size_t wakeRound(Peer* peer) const;
     Network& operator=(const Network &rhs) = delete;
     Network(const Network &rhs) = delete;
 
     void clearExisting();
 
+    // the neighbors of a slot
+    NeighborView row(int slot) const { return _regular.empty() ? _adjacency.row(slot) : _regular.row(slot); }
+
+    // connect a channel from one slot to another with the distribution's properties
+    void connectChannel(Channel& channel, int sourceSlot, int targetSlot);
+    // set up the link of an implicit channel from one slot to another, in the target's
+    // shared channel
+    void connectLink(ChannelLink& link, int sourceSlot, int targetSlot);
+
 public:
     Network();
     ~Network();
     
     void setDistribution (json distribution) {_distribution = distribution;}
+    void setActiveScheduling (bool active) {_activeScheduling = active;}
+    void setFusedPhases (bool fused) {_fusedPhases = fused;}
+    void setScheduler (json scheduler) {_scheduler.setParameters(scheduler);}
+    void setPeerArena (bool arena, bool hugePages) {_usePeerArena = arena; _arena.setHugePages(hugePages);}
+    // key the random streams of the next initNetwork by (seed, test)
+    void setSeed (uint64_t seed, int test) {_seed = seed; _test = static_cast<uint32_t>(test);}
     // -------------- TOPOLOGY INIT --------------
     // This can create the peers, set up neighbors, etc.
     void initNetwork(json topology);
 
     // -------------- Topology Helpers --------------
-    // Each function sets up "neighbors" among subsets of _peers
+    // Each function builds the adjacency ("neighbors") among subsets of _peers
     void fullyConnect(int numberOfPeers);
     void star(int numberOfPeers);
     void grid(int height, int width);
@@ -67,16 +153,33 @@ public:
     void createInitialChannels();
 
     // -------------- Specialized Initilization ------------
-    void initParameters(json parameters) {
-        _peers[0]->initParameters(_peers, parameters);
-    }
+    // the first peer's initParameters, then initPeer on every peer in parallel
+    void initParameters(json parameters, BS::thread_pool& pool);
 
     // -------------- Simulation loop --------------
+    // Runs the receive and computation phases of a round on the pool and
+    // returns how many peers were dispatched.
+    int runRound(BS::thread_pool& pool);
+
+    // max / mean thread work time of the last round (needs reportImbalance)
+    double loadImbalance() const { return _scheduler.imbalance(); }
+
     // call each peer's receive, tryPerformComputation.
     void receive(int begin, int end);    
     void tryPerformComputation(int begin, int end);
-
-    void endOfRound() {_peers[0]->endOfRound(_peers); }
+    // receive then tryPerformComputation for each peer in the range, in a single pass.
+    // Packets sent this round never arrive before the next one, so a peer cannot
+    // see a message sent by a peer that computed earlier in the same pass.
+    void receiveAndCompute(int begin, int end);
+
+    // the first peer's endOfRound, then the per-peer metrics reduction if the peers use it
+    void endOfRound(BS::thread_pool& pool);
+    // whether endOfRound has to run in rounds fast-forward skips
+    bool endOfRoundWhenIdle() const { return !_peers.empty() && _peers[0]->endOfRoundWhenIdle(); }
+
+    // Earliest round in which any peer has a message to receive or has asked to be
+    // woken up. Rounds before it would do nothing and can be skipped.
+    size_t nextEventRound() const;
 
     // -------------- Access by index --------------
     // (Might be optional if you rarely do random access.)
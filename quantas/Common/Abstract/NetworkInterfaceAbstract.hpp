@@ -1,13 +1,18 @@
 #ifndef NETWORK_INTERFACE_ABSTRACT_HPP
 #define NETWORK_INTERFACE_ABSTRACT_HPP
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
-#include <map>
 #include <set>
+#include <vector>
 #include <deque>
 #include <string>
 #include <algorithm>
+#include <functional>
+#include <type_traits>
 #include "Channel.hpp"
+#include "Inbox.hpp"
 #include "../Packet.hpp"
 #include "../NetworkInterface.hpp"
 
@@ -15,15 +20,84 @@ namespace quantas {
 
 class NetworkInterfaceAbstract : public NetworkInterface {
 private:
-    static inline interfaceId s_internalCounter = NO_PEER_ID;
+    // per thread so that tests running concurrently (each building its network on
+    // its own thread) number their interfaces independently
+    static inline thread_local interfaceId s_internalCounter = NO_PEER_ID;
+
+    // Inbound channels, ordered by source public ID
+    std::vector<Channel*> _inBoundChannels;
+    // one bit per inbound channel, set by the channel while it holds packets: receive
+    // visits the ready channels only, still in the order above
+    std::unique_ptr<std::atomic<uint64_t>[]> _ready;
+    size_t _readyWords = 0;
+
+    // calls f on each inbound channel holding packets, in order
+    template <typename F>
+    inline void forEachReady(F f) {
+        for (size_t word = 0; word < _readyWords; ++word) {
+            uint64_t bits = _ready[word].load(std::memory_order_acquire);
+            while (bits != 0) {
+                const size_t bit = static_cast<size_t>(__builtin_ctzll(bits));
+                bits &= bits - 1;
+                f(_inBoundChannels[word * 64 + bit]);
+            }
+        }
+    }
 
-    // Inbound channels
-    // key = source peer's public ID
-    std::multimap<interfaceId, std::shared_ptr<Channel>> _inBoundChannels;
+    // Outbound channels, one per neighbor the network wired up: _outBoundChannels[i]
+    // leads to _channelTargets[i]. The channels are an array owned by the network and
+    // the targets its row of the topology, so the position of a neighbor in the row is
+    // the index of its channel.
+    NeighborView _channelTargets;
+    Channel* _outBoundChannels = nullptr;
+
+    // calendar delivery: the inbound channels push into this queue instead of their own
+    Inbox* _inbox = nullptr;
+
+    // implicit channels: instead of wiring every edge up front, the network hands over a
+    // function that returns the channel of a neighbor, shared by all its senders, and sets
+    // the link of this edge, added on the first send to it (see LinkTable); nullptr if
+    // the network has no such peer
+    std::function<Channel*(interfaceId, ChannelLink*&)> _implicitChannel;
+
+    // true while the neighbors are still exactly the peers the channels were wired to
+    bool neighborsWired() const {
+        return _neighbors == _channelTargets;
+    }
 
-    // Outbound channels
-    // key = target peer's public ID
-    std::multimap<interfaceId, std::shared_ptr<Channel>> _outBoundChannels;
+    // the channel and link a unicast to nbr goes through, nullptr if nbr is not a neighbor
+    inline Channel* channelTo(interfaceId nbr, ChannelLink*& link) {
+        if (_implicitChannel) {
+            if (!_neighbors.contains(nbr)) return nullptr;
+            return _implicitChannel(nbr, link);
+        }
+        // the position of nbr among the wired neighbors is the index of its channel
+        const size_t target = _channelTargets.position(nbr);
+        if (target == _channelTargets.size()) return nullptr;
+        if (!neighborsWired() && !_neighbors.contains(nbr)) return nullptr;
+        link = &_outBoundChannels[target].link();
+        return &_outBoundChannels[target];
+    }
+
+    // body is a json message the packet owns, or a Payload or TypedPayload it shares
+    template <typename Body>
+    inline void send(Body body, interfaceId nbr, Channel& channel, ChannelLink& link) {
+        Packet p;
+        p.setSource(publicId());
+        p.setTarget(nbr);
+        if constexpr (std::is_same_v<Body, json>) p.setMessage(std::move(body));
+        else p.setPayload(std::move(body));
+        channel.pushPacket(std::move(p), link);
+    }
+
+    // walks the contiguous outbound channels, skipping exceptId
+    template <typename Body>
+    inline void broadcastWired(const Body& body, interfaceId exceptId) {
+        for (size_t i = 0; i < _channelTargets.size(); ++i) {
+            if (_channelTargets[i] == exceptId) continue;
+            send(body, _channelTargets[i], _outBoundChannels[i], _outBoundChannels[i].link());
+        }
+    }
 public:
 
     inline NetworkInterfaceAbstract() {
@@ -37,67 +111,115 @@ public:
 
     static inline void resetCounter() {s_internalCounter = NO_PEER_ID;}
 
-    // setters
-    inline void addInboundChannel(interfaceId srcPubId, std::shared_ptr<Channel> ch) {_inBoundChannels.emplace(srcPubId, ch);}
-    inline void addOutboundChannel(interfaceId tPubId, std::shared_ptr<Channel> ch) {_outBoundChannels.emplace(tPubId, ch);}
-    inline void removeOutboundChannelByPublic(interfaceId remotePubId) {
-        auto range = _outBoundChannels.equal_range(remotePubId);
-        _outBoundChannels.erase(range.first, range.second);
+    // setters (called by the network when it wires the channels)
+    inline void setInboundChannels(std::vector<Channel*> channels);
+    inline void setOutboundChannels(NeighborView targets, Channel* channels) {
+        _channelTargets = targets;
+        _outBoundChannels = channels;
     }
-    inline void removeOutboundChannelByInternal(interfaceId targetInternalId) {
-        auto range = _outBoundChannels.equal_range(targetInternalId);
-        for (auto channel = _outBoundChannels.begin(); channel != _outBoundChannels.end(); ++channel) {
-            if (channel->second->targetInternalId() == targetInternalId) {
-                _outBoundChannels.erase(channel);
-            }
-        }
+    inline void setInbox(Inbox* inbox) {_inbox = inbox;}
+    inline void setImplicitChannels(std::function<Channel*(interfaceId, ChannelLink*&)> channel) {
+        _implicitChannel = std::move(channel);
     }
 
     // Send messages to to others using this
     inline void unicastTo (json msg, const interfaceId& dest) override;
+    inline void unicastPayload (const Payload& payload, const interfaceId& dest) override;
+    inline bool sendsTyped() const override { return true; }
+    inline void unicastTyped (const TypedPayload& payload, const interfaceId& dest) override;
     
     // moves msgs from the channel to the inStream if they've arrived
     inline void receive() override;
 
+    // earliest round any inbound channel can deliver a message
+    inline size_t nextArrivalRound() override;
+
+    // broadcasts walk the contiguous outbound channels while the neighbors are unchanged
+    inline void broadcast(json msg) override;
+    inline void broadcastBut(json msg, const interfaceId& id) override;
+    inline void broadcastTyped(const TypedPayload& payload) override;
+
     inline void clearAll() override {
         _inStream.clear();
-        _inBoundChannels.clear();  
-        _outBoundChannels.clear();
-        _neighbors.clear();
+        _batch.clear();
+        setInboundChannels({});
+        _channelTargets = NeighborView();
+        _outBoundChannels = nullptr;
+        _inbox = nullptr;
+        _implicitChannel = nullptr;
+        clearNeighbors();
     }
 };
 
 void NetworkInterfaceAbstract::unicastTo(json msg, const interfaceId& nbr) {
-    if (_neighbors.find(nbr) == _neighbors.end()) return;
-    // find the channels with that key if they are our neighbor
-    auto range = _outBoundChannels.equal_range(nbr);
-    for (auto it = range.first; it != range.second; ++it) {
-        Packet p;
-        p.setSource(publicId());
-        p.setTarget(nbr);
-        p.setMessage(msg);
-        it->second->pushPacket(p);
-        // std::cout << "Msg: " << msg << " to " << nbr << std::endl;
+    ChannelLink* link = nullptr;
+    if (Channel* channel = channelTo(nbr, link)) send(std::move(msg), nbr, *channel, *link);
+}
+
+void NetworkInterfaceAbstract::unicastPayload(const Payload& payload, const interfaceId& nbr) {
+    ChannelLink* link = nullptr;
+    if (Channel* channel = channelTo(nbr, link)) send(payload, nbr, *channel, *link);
+}
+
+void NetworkInterfaceAbstract::unicastTyped(const TypedPayload& payload, const interfaceId& nbr) {
+    ChannelLink* link = nullptr;
+    if (Channel* channel = channelTo(nbr, link)) send(payload, nbr, *channel, *link);
+}
+
+// broadcasts share one payload among all the packets they send
+inline void NetworkInterfaceAbstract::broadcast(json msg) {
+    if (!neighborsWired()) {
+        NetworkInterface::broadcast(std::move(msg));
+        return;
+    }
+    broadcastWired(makePayload(std::move(msg)), NO_PEER_ID);
+}
+
+inline void NetworkInterfaceAbstract::broadcastBut(json msg, const interfaceId& exceptId) {
+    if (!neighborsWired()) {
+        NetworkInterface::broadcastBut(std::move(msg), exceptId);
+        return;
+    }
+    broadcastWired(makePayload(std::move(msg)), exceptId);
+}
+
+inline void NetworkInterfaceAbstract::broadcastTyped(const TypedPayload& payload) {
+    if (!neighborsWired()) {
+        NetworkInterface::broadcastTyped(payload);
+        return;
     }
+    broadcastWired(payload, NO_PEER_ID);
 }
 
 inline void NetworkInterfaceAbstract::receive() {
-    for (auto it = _inBoundChannels.begin(); it != _inBoundChannels.end(); ++it) {
-        auto &chPtr = it->second;
-
-        // reorder if needed
-        chPtr->shuffleChannel();
-
-        // pop up to chPtr->maxMsgsRec() messages that have arrived
-        int recCount = 0;
-        while (!chPtr->empty() 
-               && chPtr->frontHasArrived() 
-               && recCount < chPtr->maxMsgsRec()) 
-        {
-            Packet arrivedPkt = chPtr->popPacket();
-            _inStream.push_back(std::move(arrivedPkt));
-            ++recCount;
-        }
+    if (_inbox != nullptr) {
+        _inbox->deliver(_inStream);
+        return;
+    }
+    forEachReady([this](Channel* channel) { channel->deliverArrived(_inStream); });
+}
+
+inline size_t NetworkInterfaceAbstract::nextArrivalRound() {
+    if (_inbox != nullptr) return _inbox->nextArrivalRound();
+    size_t earliest = NO_ROUND;
+    forEachReady([&earliest](Channel* channel) {
+        earliest = std::min(earliest, channel->nextArrivalRound());
+    });
+    return earliest;
+}
+
+inline void NetworkInterfaceAbstract::setInboundChannels(std::vector<Channel*> channels) {
+    for (Channel* channel : _inBoundChannels) {
+        channel->setReadyFlag(nullptr, 0);
+    }
+    _inBoundChannels = std::move(channels);
+    _readyWords = (_inBoundChannels.size() + 63) / 64;
+    _ready = std::make_unique<std::atomic<uint64_t>[]>(_readyWords);
+    for (size_t word = 0; word < _readyWords; ++word) {
+        _ready[word].store(0, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < _inBoundChannels.size(); ++i) {
+        _inBoundChannels[i]->setReadyFlag(&_ready[i / 64], uint64_t(1) << (i % 64));
     }
 }
 
@@ -0,0 +1,193 @@
+/**
+ * The peer scheduler runs one phase of a round (receive, computation or both)
+ * over the peers dispatched that round using the simulation's thread pool.
+ *
+ * BLOCKS cuts the peers into one equal block per thread (what parallelize_loop does).
+ * WORK_STEALING gives each thread a range of peers that it consumes in small
+ * chunks from the front; a thread that runs out takes chunks from the back of
+ * another thread's range, so a few slow peers no longer hold up the barrier.
+ *
+ * Configured from the experiment's "scheduler" block:
+ *   "type"           "blocks" (default) or "workStealing"
+ *   "chunkSize"      peers per chunk, 0 (default) picks one from the range sizes
+ *   "costOrdering"   spread the peers over the threads by their cost in the previous round
+ *   "reportImbalance" log the per-round load imbalance (max / mean thread work time)
+ */
+
+#ifndef PEER_SCHEDULER_HPP
+#define PEER_SCHEDULER_HPP
+
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include "../Json.hpp"
+#include "../BS_thread_pool.hpp"
+
+namespace quantas {
+
+using nlohmann::json;
+
+enum class ScheduleStyle { SS_BLOCKS, SS_WORK_STEALING };
+
+class PeerScheduler {
+private:
+    // half open range of dispatch positions left to a thread, packed as front << 32 | back
+    // so the owner (front) and thieves (back) agree through a single compare and swap
+    struct alignas(64) Range {
+        std::atomic<uint64_t> bounds{0};
+    };
+
+    // time each thread spent running peers, summed over the phases of a round
+    struct alignas(64) WorkTime {
+        double seconds = 0.0;
+    };
+
+    ScheduleStyle _style = ScheduleStyle::SS_BLOCKS;
+    int _chunkSize = 0;
+    bool _costOrdering = false;
+    bool _measure = false;
+
+    std::vector<Range> _ranges;
+    std::vector<WorkTime> _work;
+
+    static uint64_t pack(uint32_t front, uint32_t back) { return (uint64_t(front) << 32) | back; }
+
+    static bool takeFront(Range& range, uint32_t chunk, int& begin, int& end) {
+        uint64_t cur = range.bounds.load(std::memory_order_relaxed);
+        while (true) {
+            uint32_t front = uint32_t(cur >> 32), back = uint32_t(cur);
+            if (front >= back) return false;
+            uint32_t next = std::min(back, front + chunk);
+            if (range.bounds.compare_exchange_weak(cur, pack(next, back), std::memory_order_acq_rel)) {
+                begin = int(front);
+                end = int(next);
+                return true;
+            }
+        }
+    }
+
+    static bool takeBack(Range& range, uint32_t chunk, int& begin, int& end) {
+        uint64_t cur = range.bounds.load(std::memory_order_relaxed);
+        while (true) {
+            uint32_t front = uint32_t(cur >> 32), back = uint32_t(cur);
+            if (front >= back) return false;
+            uint32_t next = (back - front > chunk) ? back - chunk : front;
+            if (range.bounds.compare_exchange_weak(cur, pack(front, next), std::memory_order_acq_rel)) {
+                begin = int(next);
+                end = int(back);
+                return true;
+            }
+        }
+    }
+
+    // first dispatch position of a thread's range
+    static int rangeStart(int thread, int threads, int count) {
+        return int(int64_t(count) * thread / threads);
+    }
+
+    template <typename F>
+    void timed(int thread, F& loop, int begin, int end) {
+        if (!_measure) {
+            loop(begin, end);
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        loop(begin, end);
+        std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+        _work[thread].seconds += took.count();
+    }
+
+public:
+    void setParameters(const json& params) {
+        _style = params.value("type", "blocks") == "workStealing" ? ScheduleStyle::SS_WORK_STEALING : ScheduleStyle::SS_BLOCKS;
+        _chunkSize = std::max(0, params.value("chunkSize", 0));
+        _costOrdering = params.value("costOrdering", false);
+        _measure = params.value("reportImbalance", false);
+    }
+
+    bool costOrdering() const { return _costOrdering; }
+
+    // call at the start of each round
+    void beginRound(int threads) {
+        if (static_cast<int>(_ranges.size()) != threads) {
+            _ranges = std::vector<Range>(threads);
+            _work = std::vector<WorkTime>(threads);
+        }
+        for (auto& work : _work) work.seconds = 0.0;
+    }
+
+    // Rearrange the dispatch list so that every thread's range gets a similar total cost:
+    // peers are handed out from the most expensive down, each to the thread with the
+    // least cost so far that still has room in its range.
+    void order(std::vector<int>& dispatch, const std::vector<double>& cost, int threads) const {
+        const int count = static_cast<int>(dispatch.size());
+        if (threads <= 1 || count <= threads) return;
+        std::vector<int> byCost = dispatch;
+        std::stable_sort(byCost.begin(), byCost.end(), [&cost](int a, int b) { return cost[a] > cost[b]; });
+        std::vector<int> next(threads);
+        std::vector<double> load(threads, 0.0);
+        for (int t = 0; t < threads; ++t) next[t] = rangeStart(t, threads, count);
+        for (int slot : byCost) {
+            int best = -1;
+            for (int t = 0; t < threads; ++t) {
+                if (next[t] < rangeStart(t + 1, threads, count) && (best < 0 || load[t] < load[best])) best = t;
+            }
+            dispatch[next[best]++] = slot;
+            load[best] += cost[slot];
+        }
+    }
+
+    // Run loop(begin, end) over [0, count) on the pool and wait for it to finish
+    template <typename F>
+    void run(BS::thread_pool& pool, int count, F&& loop) {
+        const int threads = static_cast<int>(_ranges.size());
+        if (count <= 0 || threads == 0) return;
+        BS::multi_future<void> tasks;
+        if (_style == ScheduleStyle::SS_BLOCKS) {
+            for (int t = 0; t < threads; ++t) {
+                int begin = rangeStart(t, threads, count), end = rangeStart(t + 1, threads, count);
+                if (begin < end) tasks.push_back(pool.submit([this, t, begin, end, &loop] { timed(t, loop, begin, end); }));
+            }
+            tasks.wait();
+            return;
+        }
+
+        const uint32_t chunk = _chunkSize > 0 ? uint32_t(_chunkSize) : uint32_t(std::max(1, count / (threads * 16)));
+        for (int t = 0; t < threads; ++t) {
+            _ranges[t].bounds.store(pack(rangeStart(t, threads, count), rangeStart(t + 1, threads, count)), std::memory_order_relaxed);
+        }
+        for (int t = 0; t < threads; ++t) {
+            tasks.push_back(pool.submit([this, t, threads, chunk, &loop] {
+                int begin, end;
+                while (takeFront(_ranges[t], chunk, begin, end)) {
+                    timed(t, loop, begin, end);
+                }
+                // own range is done, help the others starting with the next thread
+                for (int i = 1; i < threads; ++i) {
+                    Range& victim = _ranges[(t + i) % threads];
+                    while (takeBack(victim, chunk, begin, end)) {
+                        timed(t, loop, begin, end);
+                    }
+                }
+            }));
+        }
+        tasks.wait();
+    }
+
+    // max / mean work time over the threads for the phases run since beginRound (1 is balanced)
+    double imbalance() const {
+        double total = 0.0, most = 0.0;
+        for (auto& work : _work) {
+            total += work.seconds;
+            most = std::max(most, work.seconds);
+        }
+        if (total <= 0.0) return 1.0;
+        return most / (total / _work.size());
+    }
+};
+
+} // namespace quantas
+
+#endif /* PEER_SCHEDULER_HPP */
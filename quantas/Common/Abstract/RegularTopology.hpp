@@ -0,0 +1,112 @@
+/**
+ * Topologies whose neighbors are a closed-form function of the node's index:
+ * complete, star, grid, torus, chain, ring and unidirectional ring. Nothing is
+ * stored per edge; row(node) computes the node's neighbors as a NeighborView that
+ * describes them (a range with at most one gap, or up to four ids), so degree and
+ * membership are O(1) and a network of any size is wired instantly.
+ *
+ * The rows are exactly those the edge-list builders produce: edges to nodes
+ * outside [0, nodes) are dropped and repeated edges (small grids and tori) merged.
+ * Topologies given as a list are stored explicitly in an Adjacency instead.
+ */
+
+#ifndef REGULAR_TOPOLOGY_HPP
+#define REGULAR_TOPOLOGY_HPP
+
+#include <algorithm>
+#include "../NeighborView.hpp"
+
+namespace quantas {
+
+class RegularTopology {
+public:
+    enum class Kind { NONE, COMPLETE, STAR, GRID, TORUS, CHAIN, RING, UNIDIRECTIONAL_RING };
+
+    RegularTopology() = default;
+
+    static RegularTopology complete(int nodes) { return RegularTopology(Kind::COMPLETE, nodes); }
+    static RegularTopology star(int nodes) { return RegularTopology(Kind::STAR, nodes); }
+    static RegularTopology grid(int nodes, int height, int width) { return RegularTopology(Kind::GRID, nodes, height, width); }
+    static RegularTopology torus(int nodes, int height, int width) { return RegularTopology(Kind::TORUS, nodes, height, width); }
+    static RegularTopology chain(int nodes) { return RegularTopology(Kind::CHAIN, nodes); }
+    static RegularTopology ring(int nodes) { return RegularTopology(Kind::RING, nodes); }
+    static RegularTopology unidirectionalRing(int nodes) { return RegularTopology(Kind::UNIDIRECTIONAL_RING, nodes); }
+
+    // true unless one of the topologies above was picked
+    bool empty() const { return _kind == Kind::NONE; }
+    int nodes() const { return _nodes; }
+
+    NeighborView row(int node) const {
+        const long n = _nodes;
+        const long i = node;
+        switch (_kind) {
+        case Kind::COMPLETE:
+            return NeighborView::range(0, n, i);
+        case Kind::STAR:
+            return i == 0 ? NeighborView::range(1, n) : NeighborView::range(0, 1);
+        case Kind::CHAIN:
+            return small({i - 1, i + 1});
+        case Kind::RING:
+            if (n < 2) return NeighborView();
+            return small({(i + n - 1) % n, (i + 1) % n});
+        case Kind::UNIDIRECTIONAL_RING:
+            if (n < 2) return NeighborView();
+            return small({(i + 1) % n});
+        case Kind::GRID: {
+            if (_height <= 0 || _width <= 0 || i >= static_cast<long>(_height) * _width) return NeighborView();
+            const long row = i / _width, col = i % _width;
+            return small({col > 0 ? i - 1 : NO_PEER_ID, col + 1 < _width ? i + 1 : NO_PEER_ID,
+                          row > 0 ? i - _width : NO_PEER_ID, row + 1 < _height ? i + _width : NO_PEER_ID});
+        }
+        case Kind::TORUS: {
+            if (_height <= 0 || _width <= 0 || i >= static_cast<long>(_height) * _width) return NeighborView();
+            const long row = i / _width, col = i % _width;
+            return small({row * _width + (col + _width - 1) % _width, row * _width + (col + 1) % _width,
+                          ((row + _height - 1) % _height) * _width + col, ((row + 1) % _height) * _width + col});
+        }
+        default:
+            return NeighborView();
+        }
+    }
+
+    // total number of directed edges
+    size_t edges() const {
+        size_t total = 0;
+        for (int node = 0; node < _nodes; ++node) {
+            total += row(node).size();
+        }
+        return total;
+    }
+
+    void clear() { *this = RegularTopology(); }
+
+private:
+    RegularTopology(Kind kind, int nodes, int height = 0, int width = 0)
+        : _kind(kind), _nodes(std::max(nodes, 0)), _height(height), _width(width) {}
+
+    // the candidates that are valid nodes, sorted and without repeats
+    template <size_t N>
+    NeighborView small(const interfaceId (&candidates)[N]) const {
+        static_assert(N <= NeighborView::SMALL_MAX, "a small neighbor view holds at most SMALL_MAX ids");
+        interfaceId ids[N];
+        size_t count = 0;
+        for (interfaceId id : candidates) {
+            if (id < 0 || id >= _nodes) continue;
+            // insertion sort, at most SMALL_MAX ids
+            size_t at = count++;
+            for (; at > 0 && ids[at - 1] > id; --at) ids[at] = ids[at - 1];
+            ids[at] = id;
+        }
+        count = std::unique(ids, ids + count) - ids;
+        return NeighborView::small(ids, count);
+    }
+
+    Kind _kind = Kind::NONE;
+    int _nodes = 0;
+    int _height = 0;
+    int _width = 0;
+};
+
+} // namespace quantas
+
+#endif /* REGULAR_TOPOLOGY_HPP */
@@ -18,6 +18,12 @@ You should have received a copy of the GNU General Public License along with QUA
 #include <chrono>
 #include <thread>
 #include <fstream>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <stdexcept>
+#include <exception>
 
 #include "Network.hpp"
 #include "../LogWriter.hpp"
@@ -31,14 +37,27 @@ namespace quantas {
 
 	class Simulation {
 	private:
-		Network system;
+		// highest peak seen by any experiment so far (experiments may run concurrently)
+		static std::atomic<size_t> _peakMemoryKB;
 
-		static size_t _peakMemoryKB;
+		// runs every test of the experiment with threadCount threads per test
+		inline void runTests(const json& config, int threadCount, int concurrentTests);
+
+		// Reruns the experiment with each of its "verifyThreadCounts" and throws unless the
+		// logged metrics are bit-identical to the ones of the run with threadCount threads
+		inline void verifyThreadCounts(const json& config, int threadCount);
+
+		// one repetition of the experiment, logged under tests[test]
+		inline void runTest(const json& config, int test, Network& system, BS::thread_pool& pool);
+
+		// make every worker of the pool use the calling thread's RoundManager and LogWriter
+		// (the bound ones when tests or experiments run concurrently)
+		static inline void bindWorkers(BS::thread_pool& pool);
 	public:
 		inline void run(json config);
 	};
 
-	size_t Simulation::_peakMemoryKB = 0;
+	std::atomic<size_t> Simulation::_peakMemoryKB{0};
 
 	inline void Simulation::run(json config) {
 		std::string logFile = config.value("logFile", "cout");
@@ -47,52 +66,44 @@ namespace quantas {
 		std::chrono::time_point<std::chrono::high_resolution_clock> startTime, endTime; // chrono time points
    		std::chrono::duration<double> duration; // chrono time interval
 		startTime = std::chrono::high_resolution_clock::now();
+		const size_t startAllocations = allocationCount();
 
 		int _threadCount = config.value("threadCount", thread::hardware_concurrency()); // By default, use as many hardware cores as possible
 		if (_threadCount <= 0) { _threadCount = 1;}
 		if (_threadCount > config["topology"]["initialPeers"]) {
 			_threadCount = config["topology"]["initialPeers"];
 		}
-		int networkSize = static_cast<int>(config["topology"]["initialPeers"]);
-		
-		BS::thread_pool pool(_threadCount);
-		for (int i = 0; i < config["tests"]; i++) {
-			LogWriter::instance()->setTest(i);
-			RoundManager::instance()->setCurrentRound(0);
-			RoundManager::instance()->setLastRound(config["rounds"]);
-			// Configure the delay properties and initial topology of the network
-			system.setDistribution(config["distribution"]);
-			system.initNetwork(config["topology"]);
-			if (config.contains("parameters")) {
-				system.initParameters(config["parameters"]);
-			} else {
-				json empty;
-				system.initParameters(empty);
-			}
-			
-			//std::cout << "Test " << i + 1 << std::endl;
-			for (int j = 0; j < config["rounds"]; j++) {
-				// std::cout << "ROUND " << j + 1 << std::endl;
-				RoundManager::incrementRound();
-
-				// do the receive phase of the round
-				BS::multi_future<void> receive_loop = pool.parallelize_loop(networkSize, [this](int a, int b){system.receive(a, b);});
-				receive_loop.wait();
+		// every random draw of a run follows from the seed, pick (and log) one if none is given
+		if (!config.contains("seed")) {
+			config["seed"] = (uint64_t(std::random_device{}()) << 32) | std::random_device{}();
+		}
+		LogWriter::setValue("seed", config["seed"].get<uint64_t>());
+		// run this many tests at the same time, each with its own network, clock, log and threadCount threads
+		const int tests = config["tests"];
+		int concurrentTests = std::clamp(config.value("concurrentTests", 1), 1, std::max(tests, 1));
 
-				BS::multi_future<void> compute_loop = pool.parallelize_loop(networkSize, [this](int a, int b){system.tryPerformComputation(a, b);});
-				compute_loop.wait();
+		runTests(config, _threadCount, concurrentTests);
 
-				system.endOfRound(); // do any end of round computations
-			}
+		if (config.contains("verifyThreadCounts")) {
+			verifyThreadCounts(config, _threadCount);
 		}
 		
 		endTime = std::chrono::high_resolution_clock::now();
    		duration = endTime - startTime;
 		LogWriter::setValue("RunTime", double(duration.count()));
+		// counted process wide, like the peak memory below
+		if (config.value("reportAllocations", false)) {
+			if (AllocationsCounted) {
+				LogWriter::setValue("Allocations", allocationCount() - startAllocations);
+			} else {
+				std::cerr << "reportAllocations: build with COUNT_ALLOCATIONS=1 to count allocations" << std::endl;
+			}
+		}
 
 		size_t peakMemoryKB = getPeakMemoryKB();
-		if (_peakMemoryKB < peakMemoryKB) {
-			_peakMemoryKB = peakMemoryKB;
+		size_t previousPeak = _peakMemoryKB.load();
+		while (previousPeak < peakMemoryKB && !_peakMemoryKB.compare_exchange_weak(previousPeak, peakMemoryKB)) {}
+		if (previousPeak < peakMemoryKB) {
 			LogWriter::setValue("Peak Memory KB", peakMemoryKB);
 		} else {
 			LogWriter::setValue("Previous Peak Memory KB", peakMemoryKB);
@@ -101,7 +112,189 @@ namespace quantas {
 		LogWriter::print();
 	}
 
-	
+	inline void Simulation::runTests(const json& config, int threadCount, int concurrentTests) {
+		const int tests = config["tests"];
+		if (concurrentTests == 1) {
+			Network system;
+			BS::thread_pool pool(threadCount);
+			bindWorkers(pool);
+			for (int i = 0; i < tests; i++) {
+				runTest(config, i, system, pool);
+			}
+			return;
+		}
+
+		LogWriter* experimentLog = LogWriter::instance();
+		std::atomic<int> nextTest{0};
+		std::vector<thread> runners;
+		// error raised in each runner, rethrown once all runners are done
+		std::vector<std::exception_ptr> errors(concurrentTests);
+		for (int r = 0; r < concurrentTests; ++r) {
+			runners.emplace_back([&, r]() {
+				RoundManager rounds;
+				LogWriter log;
+				RoundManager::bind(&rounds);
+				LogWriter::bind(&log);
+				try {
+					BS::thread_pool pool(threadCount);
+					bindWorkers(pool);
+					Network system;
+					for (int i = nextTest++; i < tests; i = nextTest++) {
+						runTest(config, i, system, pool);
+						log.mergeTest(i, experimentLog);
+					}
+				} catch (...) {
+					errors[r] = std::current_exception();
+					nextTest = tests; // the other runners take no further tests
+				}
+				RoundManager::bind(nullptr);
+				LogWriter::bind(nullptr);
+			});
+		}
+		for (auto& runner : runners) {
+			runner.join();
+		}
+		for (auto& error : errors) {
+			if (error) {
+				std::rethrow_exception(error);
+			}
+		}
+	}
+
+	inline void Simulation::verifyThreadCounts(const json& config, int threadCount) {
+		// metrics that measure the run itself rather than the simulated system
+		auto simulated = [](json tests) {
+			for (auto& test : tests) {
+				test.erase("loadImbalance");
+			}
+			return tests;
+		};
+
+		LogWriter* experimentLog = LogWriter::instance();
+		const json expected = simulated(experimentLog->tests());
+		for (int threads : config["verifyThreadCounts"]) {
+			threads = std::clamp(threads, 1, config["topology"]["initialPeers"].get<int>());
+			LogWriter verifyLog;
+			LogWriter::bind(&verifyLog);
+			runTests(config, threads, 1);
+			LogWriter::bind(experimentLog);
+			const json actual = simulated(verifyLog.tests());
+			if (actual == expected) continue;
+
+			std::string where = "the logged tests";
+			for (size_t i = 0; i < std::min(actual.size(), expected.size()); ++i) {
+				if (actual[i] == expected[i]) continue;
+				where = "test " + std::to_string(i);
+				for (auto& [key, value] : expected[i].items()) {
+					if (!actual[i].contains(key) || actual[i][key] != value) {
+						where += ", metric '" + key + "'";
+						break;
+					}
+				}
+				break;
+			}
+			throw std::runtime_error("verifyThreadCounts: " + where + " differs between threadCount "
+				+ std::to_string(threadCount) + " and " + std::to_string(threads));
+		}
+		LogWriter::setValue("verifiedThreadCounts", config["verifyThreadCounts"]);
+	}
+
+	inline void Simulation::runTest(const json& config, int test, Network& system, BS::thread_pool& pool) {
+		// skip rounds in which no message arrives and no peer asked to be woken up
+		bool fastForward = config.value("fastForward", false);
+		// only dispatch peers that have a packet arriving or asked to be woken up
+		bool activeScheduling = config.value("activeScheduling", false);
+		// run receive and computation for a peer back to back with one barrier per round
+		bool fusedPhases = config.value("fusedPhases", false);
+		// how the peers of each phase are split over the threads (see PeerScheduler.hpp)
+		json scheduler = config.value("scheduler", json::object());
+		bool reportImbalance = scheduler.value("reportImbalance", false);
+		// place the peers in one contiguous arena, optionally on huge pages (see PeerArena.hpp)
+		bool peerArena = config.value("peerArena", false);
+		bool hugePages = config.value("hugePages", false);
+
+		LogWriter::instance()->setTest(test);
+		RoundManager::instance()->setCurrentRound(0);
+		RoundManager::instance()->setLastRound(config["rounds"]);
+		// Configure the delay properties and initial topology of the network
+		system.setSeed(config["seed"].get<uint64_t>(), test);
+		system.setDistribution(config["distribution"]);
+		system.setActiveScheduling(activeScheduling);
+		system.setFusedPhases(fusedPhases);
+		system.setScheduler(scheduler);
+		system.setPeerArena(peerArena, hugePages);
+		system.initNetwork(config["topology"]);
+		if (config.contains("parameters")) {
+			system.initParameters(config["parameters"], pool);
+		} else {
+			json empty;
+			system.initParameters(empty, pool);
+		}
+		
+		//std::cout << "Test " << test + 1 << std::endl;
+		size_t skippedRounds = 0;
+		size_t dispatchedPeers = 0;
+		while (RoundManager::currentRound() < RoundManager::lastRound()) {
+			// std::cout << "ROUND " << RoundManager::currentRound() + 1 << std::endl;
+			RoundManager::incrementRound();
+
+			// receive and compute on the peers that run this round (all of them unless activeScheduling is set)
+			int dispatched = system.runRound(pool);
+			if (activeScheduling) {
+				dispatchedPeers += dispatched;
+			}
+			if (reportImbalance) {
+				LogWriter::pushValue("loadImbalance", system.loadImbalance());
+			}
+
+			system.endOfRound(pool); // do any end of round computations
+
+			if (fastForward) {
+				// the last round always runs so end of run metrics are still logged
+				size_t nextRound = std::min(system.nextEventRound(), RoundManager::lastRound());
+				if (nextRound > RoundManager::currentRound() + 1 && !system.endOfRoundWhenIdle()) {
+					skippedRounds += nextRound - RoundManager::currentRound() - 1;
+					RoundManager::setCurrentRound(nextRound - 1);
+				}
+				// otherwise skipped rounds still end (see Peer::nextWakeRound), which may
+				// give the peers work in the round after
+				while (nextRound > RoundManager::currentRound() + 1) {
+					RoundManager::incrementRound();
+					++skippedRounds;
+					system.endOfRound(pool);
+					nextRound = std::min(system.nextEventRound(), RoundManager::lastRound());
+				}
+			}
+		}
+		if (fastForward) {
+			LogWriter::pushValue("skippedRounds", skippedRounds);
+		}
+		if (activeScheduling) {
+			LogWriter::pushValue("dispatchedPeers", dispatchedPeers);
+		}
+	}
+
+	inline void Simulation::bindWorkers(BS::thread_pool& pool) {
+		RoundManager* rounds = RoundManager::instance();
+		LogWriter* log = LogWriter::instance();
+		const size_t workers = pool.get_thread_count();
+		// one task per worker: each task waits until all have started, so no worker runs two
+		std::mutex mtx;
+		std::condition_variable allStarted;
+		size_t started = 0;
+		BS::multi_future<void> tasks;
+		for (size_t w = 0; w < workers; ++w) {
+			tasks.push_back(pool.submit([&]() {
+				RoundManager::bind(rounds);
+				LogWriter::bind(log);
+				std::unique_lock<std::mutex> lock(mtx);
+				++started;
+				allStarted.notify_all();
+				allStarted.wait(lock, [&]() { return started == workers; });
+			}));
+		}
+		tasks.wait();
+	}
 }
 
 #endif /* Simulation_hpp */
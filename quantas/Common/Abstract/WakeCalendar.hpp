@@ -0,0 +1,97 @@
+/**
+ * The wake calendar records, for each future round, which peers have something
+ * to do in it: a packet arriving on one of their inbound channels or a wake-up
+ * they asked for. With active scheduling the network only dispatches the peers
+ * due in the current round instead of every peer.
+ *
+ * Peers are identified by their slot (index) in the network's peer vector.
+ * schedule() may be called concurrently from the compute phase; takeDue() and
+ * nextRound() are only called between phases.
+ */
+
+#ifndef WAKE_CALENDAR_HPP
+#define WAKE_CALENDAR_HPP
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include "../RoundManager.hpp"
+
+namespace quantas {
+
+class WakeCalendar {
+private:
+    // peers are spread over shards by slot so concurrent senders rarely contend
+    static const int SHARDS = 64;
+
+    struct Shard {
+        std::mutex mtx;
+        std::map<size_t, std::vector<int>> rounds;
+    };
+
+    Shard _shards[SHARDS];
+
+    // last round each slot was scheduled for, filters out repeated registrations
+    // (e.g. a broadcast landing n packets on a peer for the same round)
+    std::unique_ptr<std::atomic<size_t>[]> _lastScheduled;
+    int _slots = 0;
+
+public:
+    WakeCalendar() = default;
+    WakeCalendar(const WakeCalendar&) = delete;
+    WakeCalendar& operator=(const WakeCalendar&) = delete;
+
+    // drop everything scheduled and size the calendar for a number of peers
+    void reset(int slots) {
+        for (auto& shard : _shards) {
+            shard.rounds.clear();
+        }
+        _slots = slots;
+        _lastScheduled.reset(new std::atomic<size_t>[slots]);
+        for (int i = 0; i < slots; ++i) {
+            _lastScheduled[i].store(NO_ROUND, std::memory_order_relaxed);
+        }
+    }
+
+    // ask for the peer in slot to be dispatched in round
+    void schedule(size_t round, int slot) {
+        if (round == NO_ROUND || slot < 0 || slot >= _slots) return;
+        if (_lastScheduled[slot].exchange(round, std::memory_order_relaxed) == round) return;
+        Shard& shard = _shards[slot % SHARDS];
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        shard.rounds[round].push_back(slot);
+    }
+
+    // removes and returns the slots due in round (or earlier), sorted and unique
+    std::vector<int> takeDue(size_t round) {
+        std::vector<int> due;
+        for (auto& shard : _shards) {
+            auto it = shard.rounds.begin();
+            while (it != shard.rounds.end() && it->first <= round) {
+                due.insert(due.end(), it->second.begin(), it->second.end());
+                it = shard.rounds.erase(it);
+            }
+        }
+        std::sort(due.begin(), due.end());
+        due.erase(std::unique(due.begin(), due.end()), due.end());
+        return due;
+    }
+
+    // earliest round with anything scheduled (NO_ROUND if none)
+    size_t nextRound() const {
+        size_t earliest = NO_ROUND;
+        for (auto& shard : _shards) {
+            if (!shard.rounds.empty()) {
+                earliest = std::min(earliest, shard.rounds.begin()->first);
+            }
+        }
+        return earliest;
+    }
+};
+
+} // namespace quantas
+
+#endif /* WAKE_CALENDAR_HPP */
@@ -23,6 +23,7 @@
 
 #include "Network.hpp"
 #include "Simulation.hpp"
+#include "ExperimentExecutor.hpp"
 #include "../NetworkInterface.hpp"
 #include "../Json.hpp"
 
@@ -44,10 +45,13 @@ int main(int argc, const char* argv[]) {
    json config;
    inFile >> config;
 
-   for (int i = 0; i < config["experiments"].size(); ++i) {
-      json input = config["experiments"][i];
-      quantas::Simulation sim;
-	   sim.run(input);
+   quantas::ExperimentExecutor executor;
+   executor.setParameters(config);
+   try {
+      executor.run(config["experiments"]);
+   } catch (const std::exception& e) {
+      std::cerr << "error: " << e.what() << std::endl;
+      return 1;
    }
 
    return 0;
@@ -0,0 +1,101 @@
+/*
+  Copyright 2024
+
+  This file is part of QUANTAS.  QUANTAS is free software: you can
+  redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either
+  version 3 of the License, or (at your option) any later version.
+  QUANTAS is distributed in the hope that it will be useful, but WITHOUT
+  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+  FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+  for more details.  You should have received a copy of the GNU General
+  Public License along with QUANTAS. If not, see
+  <https://www.gnu.org/licenses/>.
+
+*/
+
+// Counting replacement of the global operator new and delete (see allocationCount),
+// only linked into builds made with COUNT_ALLOCATIONS=1 so that other builds keep the
+// standard allocator. Each thread bumps one of a few padded counters, so counting
+// costs no contention.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <cstddef>
+
+namespace {
+
+struct alignas(64) AllocationSlot { std::atomic<size_t> count{0}; };
+const unsigned AllocationSlots = 64;
+AllocationSlot allocationSlots[AllocationSlots];
+std::atomic<unsigned> nextAllocationSlot{0};
+thread_local unsigned allocationSlot = AllocationSlots;
+
+void countAllocation() {
+   if (allocationSlot == AllocationSlots) {
+      allocationSlot = nextAllocationSlot.fetch_add(1, std::memory_order_relaxed) % AllocationSlots;
+   }
+   allocationSlots[allocationSlot].count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* allocate(std::size_t size) noexcept {
+   countAllocation();
+   return std::malloc(size ? size : 1);
+}
+
+void* allocate(std::size_t size, std::align_val_t alignment) noexcept {
+   countAllocation();
+   const std::size_t align = static_cast<std::size_t>(alignment);
+   // aligned_alloc wants a size that is a multiple of the alignment
+   return std::aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align);
+}
+
+}
+
+// declared in memoryUtil.hpp (not included here: it also defines getPeakMemoryKB)
+size_t allocationCount() {
+   size_t total = 0;
+   for (const auto& slot : allocationSlots) total += slot.count.load(std::memory_order_relaxed);
+   return total;
+}
+
+void* operator new(std::size_t size) {
+   if (void* p = allocate(size)) return p;
+   throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) {
+   if (void* p = allocate(size)) return p;
+   throw std::bad_alloc();
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+   if (void* p = allocate(size, alignment)) return p;
+   throw std::bad_alloc();
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+   if (void* p = allocate(size, alignment)) return p;
+   throw std::bad_alloc();
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+   return allocate(size, alignment);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+   return allocate(size, alignment);
+}
+
+// every form of delete frees what malloc or aligned_alloc returned
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { std::free(p); }
@@ -54,41 +54,43 @@ inline ByzantinePeer() {}
     virtual void unicastTo (json msg, const interfaceId& dest) override { 
         bool skipRegular = faultManager.applyUnicastTo(this, msg, dest);
         if (!skipRegular) 
-            _networkInterface->unicastTo(msg, dest);
+            _networkInterface->unicastTo(std::move(msg), dest);
     };
 
     virtual void unicast (json msg) override { 
         bool skipRegular = faultManager.applySend(this, msg, "unicast");
         if (!skipRegular) 
-            _networkInterface->unicast(msg);
+            _networkInterface->unicast(std::move(msg));
     };
 
     virtual void multicast (json msg, const std::set<interfaceId>& targets) override { 
         bool skipRegular = faultManager.applySend(this, msg, "multicast", targets);
         if (!skipRegular) 
-            _networkInterface->multicast(msg, targets);
+            _networkInterface->multicast(std::move(msg), targets);
     };
 
     virtual void broadcast (json msg) override { 
         bool skipRegular = faultManager.applySend(this, msg, "broadcast");
         if (!skipRegular) 
-            _networkInterface->broadcast(msg);
+            _networkInterface->broadcast(std::move(msg));
     };
 
     virtual void broadcastBut (json msg, const interfaceId& id) override { 
-        _networkInterface->broadcastBut(msg, id); 
+        _networkInterface->broadcastBut(std::move(msg), id); 
     };
 
     virtual void randomMulticast (json msg) override { 
         bool skipRegular = faultManager.applySend(this, msg, "randomMulticast");
         if (!skipRegular) 
-            _networkInterface->randomMulticast(msg);
+            _networkInterface->randomMulticast(std::move(msg));
     };
 
     // moves msgs to the inStream if they've arrived
     void receive() { _networkInterface->receive(); };
 
     void addFault(Fault* fault) {faultManager.addFault(fault);};
+    // true if a fault rewrites this peer's messages, which then have to be sent as json
+    bool faultsOnSend() const {return faultManager.interceptsSends();};
 
 protected:
     FaultManager faultManager;
@@ -14,6 +14,7 @@
 #include "../LogWriter.hpp"
 #include "../Packet.hpp"
 #include "../NetworkInterface.hpp"
+#include "../SpscQueue.hpp"
 #include "ipUtil.hpp"
 #include "../Json.hpp"
 #include "../BS_thread_pool.hpp"
@@ -52,6 +53,8 @@ private:
     BS::thread_pool pool{1}; // currently only 1 thread is allowed to exist for sending messages
 
     std::map<interfaceId, NeighborInfo> all_peers;
+    // packets from the listener thread, moved to the inStream by receive()
+    SpscQueue<Packet> arrivals;
     // Use a thread pool or message dispatch queue so you don’t spawn hundreds of threads.
     void send_json(const std::string& ip, int port, const json& jmsg, bool async = true) {
         auto task = [=]() {
@@ -218,11 +221,9 @@ private:
                         }
                     }
                 } else if (type == "message") {
-                    std::lock_guard<std::mutex> lock(_inStream_mtx);
                     interfaceId sender = msg.value("from_id", -1);
                     if (sender == -1) continue;
-                    Packet arrivedPkt(_publicId, sender, msg["body"]);
-                    _inStream.push_back(std::move(arrivedPkt));
+                    arrivals.push(Packet(_publicId, sender, std::move(msg["body"])));
                     // std::cout << "Message of type | " << type << " | " << std::endl;
                 }
             } catch (...) {}
@@ -325,9 +326,13 @@ public:
     // Send messages to to others using this
     inline void unicastTo (json msg, const interfaceId& dest) override;
     
-    // no need to move from channels to instream
-    // moves msgs from the channel to the inStream if they've arrived
-    inline void receive() override {};
+    // moves the msgs the listener received since the last call to the inStream
+    inline void receive() override {
+        Packet arrived;
+        while (arrivals.pop(arrived)) {
+            _inStream.push_back(std::move(arrived));
+        }
+    };
 
     inline void clearAll() override {
         std::cout << "ClearAll" << std::endl;
@@ -341,8 +346,9 @@ public:
         pool.wait_for_tasks();
         std::cout << "wait_for_tasks" << std::endl;
         _inStream.clear();
+        _batch.clear();
         std::cout << "_inStream" << std::endl;
-        _neighbors.clear();
+        clearNeighbors();
         std::cout << "_neighbors" << std::endl;
         all_peers.clear();
         std::cout << "all_peers" << std::endl;
@@ -84,6 +84,11 @@ public:
         }
     }
 
+    // true if some fault looks at the messages this peer sends
+    bool interceptsSends() const {
+        return !unicastToFaults.empty() || !sendFaults.empty();
+    }
+
     bool applyUnicastTo(Peer* peer, json& msg, const interfaceId& dest) {
         bool overridden = false;
         for (auto* f : unicastToFaults)
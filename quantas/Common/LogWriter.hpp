@@ -13,9 +13,30 @@ namespace quantas {
 
     class LogWriter {
     public:
+        // Normally the process wide instance is used; separate instances exist only so
+        // concurrently running tests each log to their own data (see bind).
+        LogWriter() = default;
+
         static LogWriter* instance() {
-            static LogWriter s;
-            return &s;
+            if (bound() != nullptr) return bound();
+            return process();
+        }
+
+        // Make instance() return log on the calling thread (nullptr restores the process wide one)
+        static void bind(LogWriter* log) { bound() = log; }
+
+        // Copy the values this writer logged for a test into target
+        void mergeTest(int test, LogWriter* target) {
+            std::scoped_lock lock(_mutex, target->_mutex);
+            if (data.contains("tests") && data["tests"].size() > static_cast<size_t>(test)) {
+                target->data["tests"][test] = data["tests"][test];
+            }
+        }
+
+        // Values logged per test so far
+        json tests() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return data.value("tests", json::array());
         }
 
         // Set log file path and open stream
@@ -46,6 +67,9 @@ namespace quantas {
             LogWriter* inst = instance();
             std::lock_guard<std::mutex> lock(inst->_mutex);
             if (inst->_log_stream != nullptr) {
+                // writers of concurrently running experiments may share std::cout
+                static std::mutex outputMutex;
+                std::lock_guard<std::mutex> outputLock(outputMutex);
                 (*inst->_log_stream) << inst->data.dump(4) << std::endl;
                 inst->_log_stream->flush();
             }
@@ -89,8 +113,18 @@ namespace quantas {
         json data;
         mutable std::mutex _mutex;
 
+        static LogWriter* process() {
+            static LogWriter s;
+            return &s;
+        }
+
+        // log writer bound to the calling thread, if any
+        static LogWriter*& bound() {
+            static thread_local LogWriter* b = nullptr;
+            return b;
+        }
+
         // disallow copies
-        LogWriter() = default;
         LogWriter(const LogWriter&) = delete;
         LogWriter& operator=(const LogWriter&) = delete;
     };
@@ -0,0 +1,125 @@
+/*
+Copyright 2024
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+QUANTAS is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+//
+// Per-thread recycling of the small blocks of a message's envelope: the control block
+// and root value of a send's shared payload (see makePayload and TypedPayload) and the
+// chunks of the packet queues. The nodes inside a json body are not pooled. A block is freed into the free list of the thread that frees it and handed
+// out again by that thread's next allocation of the same size class, so the steady
+// stream of sends and deliveries stops going through the heap. Each list keeps a
+// bounded number of blocks; the rest, and every list of an exiting thread, go back
+// to the heap.
+
+#ifndef MessagePool_hpp
+#define MessagePool_hpp
+
+#include <cstddef>
+#include <new>
+
+namespace quantas {
+
+class MessagePool {
+private:
+    static constexpr size_t Classes = 5;            // 32, 64, 128, 256 and 512 bytes
+    static constexpr size_t MaxBlockSize = 512;     // larger blocks come from the heap
+    static constexpr size_t KeepPerClass = 4096;    // blocks a thread keeps per class
+
+    struct FreeBlock { FreeBlock* next; };
+
+    struct Lists {
+        FreeBlock* head[Classes] = {};
+        size_t count[Classes] = {};
+        ~Lists() {
+            released() = true;
+            for (size_t c = 0; c < Classes; ++c) {
+                while (head[c] != nullptr) {
+                    FreeBlock* block = head[c];
+                    head[c] = block->next;
+                    ::operator delete(block);
+                }
+            }
+        }
+    };
+
+    // set once the thread's lists are gone (frees after that go to the heap)
+    static bool& released() {
+        static thread_local bool r = false;
+        return r;
+    }
+    static Lists& lists() {
+        static thread_local Lists l;
+        return l;
+    }
+
+    static size_t sizeClass(size_t bytes) {
+        size_t c = 0;
+        for (size_t size = 32; size < bytes; size <<= 1) ++c;
+        return c;
+    }
+
+public:
+    static void* allocate(size_t bytes) {
+        if (bytes > MaxBlockSize || released()) return ::operator new(bytes);
+        const size_t c = sizeClass(bytes);
+        Lists& l = lists();
+        if (FreeBlock* block = l.head[c]) {
+            l.head[c] = block->next;
+            --l.count[c];
+            return block;
+        }
+        return ::operator new(size_t(32) << c);
+    }
+
+    static void deallocate(void* p, size_t bytes) {
+        if (bytes > MaxBlockSize || released()) {
+            ::operator delete(p);
+            return;
+        }
+        const size_t c = sizeClass(bytes);
+        Lists& l = lists();
+        if (l.count[c] >= KeepPerClass) {
+            ::operator delete(p);
+            return;
+        }
+        FreeBlock* block = static_cast<FreeBlock*>(p);
+        block->next = l.head[c];
+        l.head[c] = block;
+        ++l.count[c];
+    }
+};
+
+// Standard allocator drawing from MessagePool, for std::allocate_shared and containers
+template <typename T>
+struct PoolAllocator {
+    typedef T value_type;
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(MessagePool::allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { MessagePool::deallocate(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>&) const { return false; }
+};
+
+} // namespace quantas
+
+#endif /* MessagePool_hpp */
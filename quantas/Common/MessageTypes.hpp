@@ -0,0 +1,115 @@
+/*
+Copyright 2024
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+QUANTAS is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+//
+// Routing of json messages by their type name. MessageTypes interns every name a
+// peer handles ("Consensus", "commit", ...) to a small integer, and a MessageTable
+// maps those integers to handlers, so a received message is routed with one lookup
+// of its type field and an array index instead of a chain of string comparisons.
+//
+// Names are interned when the tables are built. Build them as statics (as the
+// peers do), so that every name is known before the simulation starts: lookups
+// while messages are handled do not lock.
+
+#ifndef MessageTypes_hpp
+#define MessageTypes_hpp
+
+#include <deque>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Json.hpp"
+
+namespace quantas {
+
+using nlohmann::json;
+
+// the id of a name that was never interned
+inline static const int NO_MESSAGE_TYPE = -1;
+
+class MessageTypes {
+private:
+    std::mutex _mtx;
+    std::unordered_map<std::string, int> _ids;
+    std::deque<std::string> _names;     // indexed by id
+
+    static MessageTypes& instance() {
+        static MessageTypes s;
+        return s;
+    }
+
+public:
+    // the id of name, registering it if it is new
+    static int intern(const std::string& name) {
+        MessageTypes& types = instance();
+        std::lock_guard<std::mutex> lock(types._mtx);
+        auto [it, inserted] = types._ids.emplace(name, static_cast<int>(types._names.size()));
+        if (inserted) types._names.push_back(name);
+        return it->second;
+    }
+
+    // the id of name, NO_MESSAGE_TYPE if it was never interned
+    static int find(const std::string& name) {
+        const MessageTypes& types = instance();
+        auto it = types._ids.find(name);
+        return it == types._ids.end() ? NO_MESSAGE_TYPE : it->second;
+    }
+
+    // the id of the string msg[key], NO_MESSAGE_TYPE if it is missing or unknown
+    static int find(const json& msg, const char* key) {
+        auto it = msg.find(key);
+        if (it == msg.end() || !it->is_string()) return NO_MESSAGE_TYPE;
+        return find(it->get_ref<const std::string&>());
+    }
+
+    static const std::string& name(int id) { return instance()._names.at(id); }
+};
+
+// Handlers indexed by message type id. Handler is anything that converts to false
+// when empty: a function pointer, a member function pointer or a std::function.
+template <typename Handler>
+class MessageTable {
+private:
+    std::vector<Handler> _handlers;
+
+public:
+    MessageTable(std::initializer_list<std::pair<const char*, Handler>> entries) {
+        for (const auto& [name, handler] : entries) {
+            const int id = MessageTypes::intern(name);
+            if (static_cast<size_t>(id) >= _handlers.size()) _handlers.resize(id + 1);
+            _handlers[id] = handler;
+        }
+    }
+
+    // the handler for a type id, an empty Handler if there is none
+    Handler find(int type) const {
+        if (type < 0 || static_cast<size_t>(type) >= _handlers.size()) return Handler();
+        return _handlers[type];
+    }
+
+    // the handler for the type named by msg[key]
+    Handler find(const json& msg, const char* key) const {
+        return find(MessageTypes::find(msg, key));
+    }
+};
+
+} // namespace quantas
+
+#endif /* MessageTypes_hpp */
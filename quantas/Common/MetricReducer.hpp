@@ -0,0 +1,104 @@
+#ifndef MetricReducer_hpp
+#define MetricReducer_hpp
+
+#include <map>
+#include <string>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+#include <unordered_map>
+
+namespace quantas {
+
+    // Collects per-peer contributions to the metrics of a round. Each thread fills its
+    // own reducer through Peer::collectMetrics and the partial results are merged, so
+    // every metric names how it combines: a sum, a minimum, a maximum or a histogram
+    // (bucket -> count). Using the same key with two different reductions is an error.
+    class MetricReducer {
+    public:
+        enum class Reduction { SUM, MIN, MAX, HISTOGRAM };
+
+        void sum(const std::string& key, double value) {
+            metric(key, Reduction::SUM).value += value;
+        }
+
+        void min(const std::string& key, double value) {
+            Metric& m = metric(key, Reduction::MIN);
+            m.value = std::min(m.value, value);
+        }
+
+        void max(const std::string& key, double value) {
+            Metric& m = metric(key, Reduction::MAX);
+            m.value = std::max(m.value, value);
+        }
+
+        void histogram(const std::string& key, long long bucket, long long count = 1) {
+            metric(key, Reduction::HISTOGRAM).buckets[bucket] += count;
+        }
+
+        // combine another (partial) reducer into this one
+        void merge(const MetricReducer& other) {
+            for (const auto& [key, theirs] : other._metrics) {
+                Metric& mine = metric(key, theirs.reduction);
+                switch (theirs.reduction) {
+                case Reduction::SUM:
+                    mine.value += theirs.value;
+                    break;
+                case Reduction::MIN:
+                    mine.value = std::min(mine.value, theirs.value);
+                    break;
+                case Reduction::MAX:
+                    mine.value = std::max(mine.value, theirs.value);
+                    break;
+                case Reduction::HISTOGRAM:
+                    for (const auto& [bucket, count] : theirs.buckets) {
+                        mine.buckets[bucket] += count;
+                    }
+                    break;
+                }
+            }
+        }
+
+        bool contains(const std::string& key) const { return _metrics.count(key) != 0; }
+
+        // reduced value of a sum/min/max metric, fallback if no peer contributed to it
+        double get(const std::string& key, double fallback = 0.0) const {
+            auto it = _metrics.find(key);
+            return it == _metrics.end() ? fallback : it->second.value;
+        }
+
+        // merged buckets of a histogram metric (empty if no peer contributed to it)
+        const std::map<long long, long long>& buckets(const std::string& key) const {
+            static const std::map<long long, long long> empty;
+            auto it = _metrics.find(key);
+            return it == _metrics.end() ? empty : it->second.buckets;
+        }
+
+        void clear() { _metrics.clear(); }
+
+    private:
+        struct Metric {
+            Reduction reduction;
+            double value;
+            std::map<long long, long long> buckets;
+        };
+
+        Metric& metric(const std::string& key, Reduction reduction) {
+            auto it = _metrics.find(key);
+            if (it == _metrics.end()) {
+                double identity = 0.0;
+                if (reduction == Reduction::MIN) identity = std::numeric_limits<double>::infinity();
+                if (reduction == Reduction::MAX) identity = -std::numeric_limits<double>::infinity();
+                it = _metrics.emplace(key, Metric{reduction, identity, {}}).first;
+            } else if (it->second.reduction != reduction) {
+                throw std::logic_error("MetricReducer: metric '" + key + "' used with two different reductions");
+            }
+            return it->second;
+        }
+
+        std::unordered_map<std::string, Metric> _metrics;
+    };
+
+}
+
+#endif /* MetricReducer_hpp */
@@ -0,0 +1,190 @@
+/*
+Copyright 2022
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+QUANTAS is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef NeighborView_hpp
+#define NeighborView_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include "Packet.hpp"
+
+namespace quantas {
+
+class NeighborViewIterator;
+
+// Read only view of a peer's neighbors, a sorted run of unique ids. It reads like
+// the std::set it replaces (iteration in id order, find, count, size) but is free
+// to copy. A view either points into storage it does not own (normally one row of
+// the network's adjacency) or describes the row itself, for topologies whose
+// neighbors follow from the peer's index (see RegularTopology):
+// - range(first, last, skip): every id in [first, last) except skip
+// - small(ids, count): up to four ids held in the view
+// Indexing, size and membership are O(1) for described rows. A view into storage
+// stays valid until the topology it points into is rebuilt.
+class NeighborView {
+public:
+    using value_type = interfaceId;
+    using const_iterator = NeighborViewIterator;
+    using iterator = const_iterator;
+
+    static constexpr size_t SMALL_MAX = 4;
+
+    NeighborView() = default;
+    NeighborView(const interfaceId* first, const interfaceId* last) : _first(first), _last(last) {}
+
+    static NeighborView range(interfaceId first, interfaceId last, interfaceId skip = NO_PEER_ID) {
+        NeighborView view;
+        view._kind = Kind::RANGE;
+        view._ids[0] = first;
+        view._ids[1] = std::max(first, last);
+        view._ids[2] = skip;
+        return view;
+    }
+
+    // ids must be sorted and unique
+    static NeighborView small(const interfaceId* ids, size_t count) {
+        NeighborView view;
+        view._kind = Kind::SMALL;
+        view._count = static_cast<uint8_t>(std::min(count, SMALL_MAX));
+        std::copy(ids, ids + view._count, view._ids);
+        return view;
+    }
+
+    inline const_iterator begin() const;
+    inline const_iterator end() const;
+
+    size_t size() const {
+        switch (_kind) {
+        case Kind::RANGE:
+            return static_cast<size_t>(_ids[1] - _ids[0]) - (skipsInside() ? 1 : 0);
+        case Kind::SMALL:
+            return _count;
+        default:
+            return static_cast<size_t>(_last - _first);
+        }
+    }
+    bool empty() const { return size() == 0; }
+
+    interfaceId operator[](size_t i) const {
+        switch (_kind) {
+        case Kind::RANGE: {
+            interfaceId id = _ids[0] + static_cast<interfaceId>(i);
+            return (skipsInside() && id >= _ids[2]) ? id + 1 : id;
+        }
+        case Kind::SMALL:
+            return _ids[i];
+        default:
+            return _first[i];
+        }
+    }
+
+    // position of id in the view, or size() if it is not a neighbor
+    size_t position(interfaceId id) const {
+        switch (_kind) {
+        case Kind::RANGE:
+            if (id < _ids[0] || id >= _ids[1] || id == _ids[2]) return size();
+            return static_cast<size_t>(id - _ids[0]) - ((skipsInside() && id > _ids[2]) ? 1 : 0);
+        case Kind::SMALL:
+            return static_cast<size_t>(std::find(_ids, _ids + _count, id) - _ids);
+        default: {
+            const interfaceId* it = std::lower_bound(_first, _last, id);
+            return (it != _last && *it == id) ? static_cast<size_t>(it - _first) : size();
+        }
+        }
+    }
+
+    inline const_iterator find(interfaceId id) const;
+    size_t count(interfaceId id) const { return contains(id) ? 1 : 0; }
+    bool contains(interfaceId id) const { return position(id) != size(); }
+
+    // the storage the view points into (nullptr for described rows)
+    const interfaceId* data() const { return _kind == Kind::SPAN ? _first : nullptr; }
+
+    // same row: the same storage, or the same description
+    bool operator==(const NeighborView& other) const {
+        if (_kind != other._kind) return false;
+        switch (_kind) {
+        case Kind::RANGE:
+            return std::equal(_ids, _ids + 3, other._ids);
+        case Kind::SMALL:
+            return _count == other._count && std::equal(_ids, _ids + _count, other._ids);
+        default:
+            return _first == other._first && _last == other._last;
+        }
+    }
+    bool operator!=(const NeighborView& other) const { return !(*this == other); }
+
+private:
+    enum class Kind : uint8_t { SPAN, RANGE, SMALL };
+
+    bool skipsInside() const { return _ids[2] >= _ids[0] && _ids[2] < _ids[1]; }
+
+    const interfaceId* _first = nullptr;
+    const interfaceId* _last = nullptr;
+    interfaceId _ids[SMALL_MAX] = {};
+    Kind _kind = Kind::SPAN;
+    uint8_t _count = 0;
+};
+
+// Iterates a NeighborView by position; it holds a copy of the view, so it stays
+// valid when the view it came from was a temporary.
+class NeighborViewIterator {
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = interfaceId;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = interfaceId;
+
+    NeighborViewIterator() = default;
+    NeighborViewIterator(const NeighborView& view, size_t pos) : _view(view), _pos(pos) {}
+
+    interfaceId operator*() const { return _view[_pos]; }
+    interfaceId operator[](difference_type n) const { return _view[_pos + n]; }
+
+    NeighborViewIterator& operator++() { ++_pos; return *this; }
+    NeighborViewIterator operator++(int) { NeighborViewIterator it = *this; ++_pos; return it; }
+    NeighborViewIterator& operator--() { --_pos; return *this; }
+    NeighborViewIterator operator--(int) { NeighborViewIterator it = *this; --_pos; return it; }
+    NeighborViewIterator& operator+=(difference_type n) { _pos += n; return *this; }
+    NeighborViewIterator& operator-=(difference_type n) { _pos -= n; return *this; }
+    NeighborViewIterator operator+(difference_type n) const { NeighborViewIterator it = *this; return it += n; }
+    NeighborViewIterator operator-(difference_type n) const { NeighborViewIterator it = *this; return it -= n; }
+    difference_type operator-(const NeighborViewIterator& other) const {
+        return static_cast<difference_type>(_pos) - static_cast<difference_type>(other._pos);
+    }
+
+    // iterators of the same row compare by position
+    bool operator==(const NeighborViewIterator& other) const { return _pos == other._pos && _view == other._view; }
+    bool operator!=(const NeighborViewIterator& other) const { return !(*this == other); }
+    bool operator<(const NeighborViewIterator& other) const { return _pos < other._pos; }
+
+private:
+    NeighborView _view;
+    size_t _pos = 0;
+};
+
+inline NeighborView::const_iterator NeighborView::begin() const { return const_iterator(*this, 0); }
+inline NeighborView::const_iterator NeighborView::end() const { return const_iterator(*this, size()); }
+inline NeighborView::const_iterator NeighborView::find(interfaceId id) const { return const_iterator(*this, position(id)); }
+
+} // namespace quantas
+
+#endif /* NeighborView_hpp */
@@ -7,8 +7,11 @@
 #include <deque>
 #include <string>
 #include <algorithm>
-#include <mutex>
+#include <stdexcept>
+#include <vector>
 #include "Packet.hpp"
+#include "NeighborView.hpp"
+#include "PeerArena.hpp"
 
 namespace quantas {
 
@@ -18,50 +21,92 @@ protected:
     interfaceId _publicId{NO_PEER_ID};
     interfaceId _internalId{NO_PEER_ID};
 
-    // set of public ids this peer thinks it is currently directly connected to 
-    std::set<interfaceId> _neighbors;
-
-    // Our local arrived messages
-    std::deque<Packet> _inStream;
+    // sorted public ids this peer thinks it is currently directly connected to. Normally a
+    // row of the network's topology; the first addNeighbor or removeNeighbor copies it
+    // into _ownNeighbors, which the view then points at
+    NeighborView _neighbors;
+    std::vector<interfaceId> _ownNeighbors;
+
+    // make _neighbors a view of _ownNeighbors, copying the current neighbors there first
+    inline void ownNeighbors() {
+        if (_neighbors.data() != nullptr && _neighbors.data() == _ownNeighbors.data()) return;
+        _ownNeighbors.assign(_neighbors.begin(), _neighbors.end());
+        _neighbors = NeighborView(_ownNeighbors.data(), _ownNeighbors.data() + _ownNeighbors.size());
+    }
 
-    // mutex lock for adding and removing messages from _inStream
-    std::mutex _inStream_mtx;
+    // Our local arrived messages. Only the thread running the peer touches them: an
+    // interface fed by another thread hands packets over in receive()
+    PacketQueue _inStream;
+    // the packets of the last drainInStream(), kept so that its buffers are reused
+    PacketQueue _batch;
 public:
     inline NetworkInterface() {};
     inline NetworkInterface(interfaceId pubId) : _publicId(pubId) {};
     inline NetworkInterface(interfaceId pubId, interfaceId internalId) : _publicId(pubId), _internalId(internalId) {};
     inline virtual ~NetworkInterface() {};
 
+    // placed next to the other interfaces in the network's PeerArena while one is open
+    static void* operator new(size_t bytes) { return PeerArena::allocateObject(PeerArena::Interfaces, bytes); }
+    static void operator delete(void* p) { PeerArena::freeObject(p); }
+
     // getters
     inline interfaceId publicId()   const { return _publicId; }
     inline interfaceId internalId() const { return _internalId; }
-    inline std::set<interfaceId> neighbors() const {return _neighbors; }
+    inline NeighborView neighbors() const {return _neighbors; }
     inline void setPublicId(interfaceId pid) { _publicId = pid; }
-    inline void addNeighbor(interfaceId nbr) {_neighbors.insert(nbr);};
-    inline void removeNeighbor(interfaceId nbr) {_neighbors.erase(nbr);};
+    // point at a row of the network's topology (see Adjacency and RegularTopology)
+    inline void setNeighbors(NeighborView nbrs) { _neighbors = nbrs; _ownNeighbors.clear(); }
+    inline void addNeighbor(interfaceId nbr) {
+        if (_neighbors.contains(nbr)) return;
+        ownNeighbors();
+        _ownNeighbors.insert(std::lower_bound(_ownNeighbors.begin(), _ownNeighbors.end(), nbr), nbr);
+        _neighbors = NeighborView(_ownNeighbors.data(), _ownNeighbors.data() + _ownNeighbors.size());
+    };
+    inline void removeNeighbor(interfaceId nbr) {
+        if (!_neighbors.contains(nbr)) return;
+        ownNeighbors();
+        _ownNeighbors.erase(std::lower_bound(_ownNeighbors.begin(), _ownNeighbors.end(), nbr));
+        _neighbors = NeighborView(_ownNeighbors.data(), _ownNeighbors.data() + _ownNeighbors.size());
+    };
+    inline void clearNeighbors() { _neighbors = NeighborView(); _ownNeighbors.clear(); }
 
     // Send messages to to others using these
     virtual void unicastTo (json msg, const interfaceId& dest) = 0;
+    // send a payload several packets may share; the default copies it into unicastTo
+    virtual void unicastPayload (const Payload& payload, const interfaceId& dest) { unicastTo(*payload, dest); }
     virtual void unicast (json msg);
     virtual void multicast (json msg, const std::set<interfaceId>& targets);
     virtual void broadcast (json msg);
     virtual void broadcastBut (json msg, const interfaceId& id);
     virtual void randomMulticast (json msg);
 
+    // Typed messages (see TypedPayload) only travel through simulated channels, as an
+    // interface that puts messages on a real network has to serialize them
+    virtual bool sendsTyped() const { return false; }
+    virtual void unicastTyped (const TypedPayload&, const interfaceId&) {
+        throw std::logic_error("this network interface cannot send typed messages");
+    }
+    inline void multicastTyped (const TypedPayload& payload, const std::set<interfaceId>& targets);
+    virtual void broadcastTyped (const TypedPayload& payload);
+
     // Pop from local arrived inStream
     inline Packet popInStream();
-    inline bool inStreamEmpty() {
-        std::lock_guard<std::mutex> lock(_inStream_mtx);
-        return _inStream.empty(); 
-    }
+    inline bool inStreamEmpty() const { return _inStream.empty(); }
+    // every packet of the inStream at once, oldest first, leaving it empty. The batch
+    // stays valid until the next call
+    inline PacketQueue& drainInStream();
 
     // moves msgs to the inStream if they've arrived
     virtual void receive() = 0;
 
+    // earliest round a message could be moved to the inStream by receive()
+    virtual size_t nextArrivalRound() { return RoundManager::currentRound() + 1; }
+
     // Clear everything
     virtual void clearAll() {
         _inStream.clear();
-        _neighbors.clear();
+        _batch.clear();
+        clearNeighbors();
     };
 };
 
@@ -73,24 +118,42 @@ public:
 inline void NetworkInterface::unicast(json msg) {
     if (!_neighbors.empty()) {
         auto firstNbr = *_neighbors.begin();
-        unicastTo(msg, firstNbr);
+        unicastTo(std::move(msg), firstNbr);
     }
 }
 
+// the sends to several peers build the payload once and share it
 inline void NetworkInterface::multicast(json msg, const std::set<interfaceId>& targets) {
+    const Payload payload = makePayload(std::move(msg));
     for (auto nbr : targets) {
-        unicastTo(msg, nbr);
+        unicastPayload(payload, nbr);
     }
 }
 
 inline void NetworkInterface::broadcast(json msg) {
-    multicast(msg, _neighbors);
+    const Payload payload = makePayload(std::move(msg));
+    for (auto nbr : _neighbors) {
+        unicastPayload(payload, nbr);
+    }
 }
 
 inline void NetworkInterface::broadcastBut(json msg, const interfaceId& exceptId) {
+    const Payload payload = makePayload(std::move(msg));
     for (auto nbr : _neighbors) {
         if (nbr == exceptId) continue;
-        unicastTo(msg, nbr);
+        unicastPayload(payload, nbr);
+    }
+}
+
+inline void NetworkInterface::multicastTyped(const TypedPayload& payload, const std::set<interfaceId>& targets) {
+    for (auto nbr : targets) {
+        unicastTyped(payload, nbr);
+    }
+}
+
+inline void NetworkInterface::broadcastTyped(const TypedPayload& payload) {
+    for (auto nbr : _neighbors) {
+        unicastTyped(payload, nbr);
     }
 }
 
@@ -104,11 +167,10 @@ inline void NetworkInterface::randomMulticast(json msg) {
     std::shuffle(temp.begin(), temp.end(), threadLocalEngine());  // Shuffle vector
     std::set<interfaceId> subset(temp.begin(), temp.begin() + count);  // Take the first 'count' elements
 
-    multicast(msg, subset);
+    multicast(std::move(msg), subset);
 }
 
 inline Packet NetworkInterface::popInStream() {
-    std::lock_guard<std::mutex> lock(_inStream_mtx);
     if (_inStream.empty()) {
         return Packet();
     }
@@ -116,6 +178,12 @@ inline Packet NetworkInterface::popInStream() {
     _inStream.pop_front();
     return p;
 }
+
+inline PacketQueue& NetworkInterface::drainInStream() {
+    _batch.clear();
+    _batch.swap(_inStream);
+    return _batch;
+}
 } // end namespace quantas
 
 #endif
@@ -19,6 +19,9 @@ You should have received a copy of the GNU General Public License along with QUA
 
 #include <iostream>
 #include <memory>
+#include <deque>
+#include <type_traits>
+#include "MessagePool.hpp"
 #include "RoundManager.hpp"
 #include "RandomUtil.hpp"
 #include "Json.hpp"
@@ -33,33 +36,101 @@ typedef long interfaceId;
 
 inline static const interfaceId NO_PEER_ID = -1;  // used to indicate invalid peer or un init peers
 
+// A message body shared by every packet it was sent in. Broadcasts and multicasts
+// build it once and hand each packet a reference, so fanning out costs no copies.
+typedef std::shared_ptr<const json> Payload;
+
+// a json body whose control block and root node come from the message pool. The body
+// itself is never const, so a packet that owns it may modify it in place.
+inline std::shared_ptr<json> makeBody(json msg) {
+    return std::allocate_shared<json>(PoolAllocator<json>(), std::move(msg));
+}
+
+inline Payload makePayload(json msg) { return makeBody(std::move(msg)); }
+
+// A message body of any C++ type, shared the same way. A struct sent this way is built
+// once and read field by field on arrival, where a json body costs a tree of nodes and
+// string keys to build and a lookup per field to read. The receiver asks for the type
+// it expects (see Packet::as), so one stream may carry typed and json messages mixed.
+class TypedPayload {
+private:
+    // one tag per type; its address identifies the type without RTTI
+    template <typename T>
+    struct Tag { static constexpr char id = 0; };
+
+    std::shared_ptr<const void> _body;
+    const void* _type{nullptr};
+
+public:
+    TypedPayload() = default;
+
+    template <typename T>
+    static TypedPayload make(T value) {
+        using Body = std::decay_t<T>;
+        TypedPayload payload;
+        payload._body = std::allocate_shared<const Body>(PoolAllocator<Body>(), std::move(value));
+        payload._type = &Tag<Body>::id;
+        return payload;
+    }
+
+    explicit operator bool() const { return _body != nullptr; }
+    template <typename T>
+    bool holds() const { return _type == &Tag<T>::id; }
+    // the body if it is a T, nullptr otherwise
+    template <typename T>
+    const T* get() const { return holds<T>() ? static_cast<const T*>(_body.get()) : nullptr; }
+};
+
 // Packet Class
 class Packet {
 private:
     interfaceId _targetId{NO_PEER_ID};  // Target node ID
     interfaceId _sourceId{NO_PEER_ID};  // Source node ID
-    json _body;                         // Message payload
+    Payload _body;                      // Message payload
+    TypedPayload _typed;                // or a typed message body instead of the json one
     int _delay{0};                      // Transmission delay
     int _round{-1};                     // Round message was sent
+    // Whether this packet alone holds _body, set when the packet builds it and cleared
+    // once it is shared (setPayload, a copy, payload()). Only an owned body is moved out
+    // or modified in place, so the receivers of a broadcast each copy and never race.
+    mutable bool _owned{false};
 
 public:
     inline Packet();
     inline Packet(interfaceId to, interfaceId from, json body);
-    inline Packet(const Packet& rhs);
-    inline Packet& operator=(const Packet& rhs);
+    // copies share the payload (neither owns it after); moves hand it over
+    inline Packet(const Packet& other);
+    inline Packet& operator=(const Packet& other);
+    Packet(Packet&&) noexcept = default;
+    Packet& operator=(Packet&&) noexcept = default;
     ~Packet() = default;
 
     // Setters
     inline void setSource(interfaceId s) { _sourceId = s; }
     inline void setTarget(interfaceId t) { _targetId = t; }
     inline void setDelay(int delayMax, int delayMin = 1);
-    inline void setMessage(json msg) { _body = msg; }
+    inline void setMessage(json msg) { _body = makeBody(std::move(msg)); _owned = true; }
+    // a payload shared with other packets, copied before any change
+    inline void setPayload(Payload payload) { _body = std::move(payload); _owned = false; }
+    inline void setPayload(TypedPayload payload) { _typed = std::move(payload); }
+    // the body, copied first unless this packet owns it (copy on write)
+    inline json& mutableMessage();
 
     // Getters
     inline interfaceId targetId() const { return _targetId; }
     inline interfaceId sourceId() const { return _sourceId; }
-    inline bool hasArrived() const { return RoundManager::currentRound() >= _round + _delay; }
-    inline json getMessage() const { return _body; }
+    inline bool hasArrived() const { return RoundManager::currentRound() >= arrivalRound(); }
+    inline size_t arrivalRound() const { return _round + _delay; }
+    // borrow the payload (valid while the packet holds it)
+    inline const json& getMessage() const;
+    // the payload to keep: moved out when this packet owns it, copied otherwise
+    inline json takeMessage();
+    // the payload to share, which this packet no longer owns
+    inline Payload payload() const { _owned = false; return _body; }
+    // the typed body if this packet carries a T (getMessage is then empty), nullptr otherwise
+    template <typename T>
+    inline const T* as() const { return _typed.get<T>(); }
+    inline const TypedPayload& typedPayload() const { return _typed; }
     inline int getDelay() const { return _delay; }
     inline int getRoundSent() const { return _round; }
 };
@@ -70,30 +141,61 @@ inline Packet::Packet() {
 }
 
 inline Packet::Packet(interfaceId to, interfaceId from, json body)
-    : _targetId(to), _sourceId(from), _body(body), _delay(0) {
+    : _targetId(to), _sourceId(from), _body(makeBody(std::move(body))), _delay(0), _owned(true) {
     _round = RoundManager::currentRound();
 }
 
-inline Packet::Packet(const Packet& rhs) 
-    : _targetId(rhs._targetId), _sourceId(rhs._sourceId), _body(rhs._body), _delay(rhs._delay), _round(rhs._round) {
+inline Packet::Packet(const Packet& other)
+    : _targetId(other._targetId), _sourceId(other._sourceId), _body(other._body),
+      _typed(other._typed), _delay(other._delay), _round(other._round) {
+    other._owned = false;
 }
 
-inline Packet& Packet::operator=(const Packet& rhs) {
-    if (this == &rhs) return *this;
-    _targetId = rhs._targetId;
-    _sourceId = rhs._sourceId;
-    _delay = rhs._delay;
-    _round = rhs._round;
-    _body = rhs._body;
+inline Packet& Packet::operator=(const Packet& other) {
+    if (this != &other) {
+        _targetId = other._targetId;
+        _sourceId = other._sourceId;
+        _body = other._body;
+        _typed = other._typed;
+        _delay = other._delay;
+        _round = other._round;
+        _owned = other._owned = false;
+    }
     return *this;
 }
 
+inline const json& Packet::getMessage() const {
+    static const json empty;
+    return _body ? *_body : empty;
+}
+
+// an owned body came from makeBody, so it is not const and may be written through
+inline json Packet::takeMessage() {
+    if (!_body) return json();
+    json body = _owned ? std::move(const_cast<json&>(*_body)) : *_body;
+    _body.reset();
+    _owned = false;
+    return body;
+}
+
+inline json& Packet::mutableMessage() {
+    if (!_owned || !_body) {
+        _body = makeBody(_body ? *_body : json());
+        _owned = true;
+    }
+    return const_cast<json&>(*_body);
+}
+
 inline void Packet::setDelay(int maxDelay, int minDelay) {
     if (maxDelay < 1) maxDelay = 1;
     if (minDelay < 1) minDelay = 1;
     if (minDelay > maxDelay) minDelay = maxDelay;
     _delay = uniformInt(minDelay, maxDelay);
 }
+
+// The queues packets wait in (channels and in streams); their chunks are recycled
+// through the message pool as the queues grow and drain each round
+typedef std::deque<Packet, PoolAllocator<Packet>> PacketQueue;
     
 } // namespace quantas
     
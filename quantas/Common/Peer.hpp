@@ -25,10 +25,12 @@ along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
 #include <algorithm>
 #include <memory>
 #include "NetworkInterface.hpp"
+#include "PeerArena.hpp"
 #include "Abstract/NetworkInterfaceAbstract.hpp"
 #include "Concrete/NetworkInterfaceConcrete.hpp"
 #include "RoundManager.hpp"
 #include "LogWriter.hpp"
+#include "MetricReducer.hpp"
 
 namespace quantas {
 
@@ -83,6 +85,10 @@ inline Peer() {}
     inline Peer(const Peer &rhs) {};
     inline virtual ~Peer() {};
 
+    // placed in the network's PeerArena while one is open (see PeerArena.hpp)
+    static void* operator new(size_t bytes) { return PeerArena::allocateObject(PeerArena::Peers, bytes); }
+    static void operator delete(void* p) { PeerArena::freeObject(p); }
+
     virtual void clearInterface() {
         if (_networkInterface != nullptr) {
             _networkInterface->clearAll();
@@ -96,6 +102,10 @@ inline Peer() {}
     virtual void initParameters(const std::vector<Peer*>& peers,
                                 json parameters) {}
 
+    // Called on every peer after initParameters, in parallel. Per-peer setup that
+    // does not touch other peers belongs here rather than in a loop in initParameters.
+    virtual void initPeer(const json& parameters) {}
+
     // try to run performComputation though it may not
     virtual void tryPerformComputation() {
         if (!isCrashed()) {
@@ -107,10 +117,36 @@ inline Peer() {}
     virtual void performComputation() = 0;
 
     // Called after performComputation in each round (subclass can override to collect metrics, etc.)
+    // With fast-forward, it is still called in every round the engine skips unless
+    // endOfRoundWhenIdle() is false (see nextWakeRound).
     virtual void endOfRound(std::vector<Peer*>& peers) {}
+
+    // Parallel end of round metrics. When reducesMetrics() is true, after endOfRound
+    // every peer adds its share of the round's metrics with collectMetrics (run on the
+    // thread pool, so only this peer may be touched) and the merged result is handed
+    // once to reportMetrics on the first peer for logging.
+    virtual bool reducesMetrics() const { return false; }
+    virtual void collectMetrics(MetricReducer& metrics) {}
+    virtual void reportMetrics(const MetricReducer& metrics, std::vector<Peer*>& peers) {}
+
+    // Earliest round in which this peer has work to do even if no message reaches it
+    // (a timer, a scheduled submission, ...). Used to fast-forward over idle rounds and,
+    // with active scheduling, to leave the peer out of rounds it has nothing to do in;
+    // the default asks to run every round. Return NO_ROUND to wait only on messages.
+    //
+    // Fast-forward must give the results of running round by round. A round in which no
+    // peer wakes and no packet arrives is not computed, but the end of round hook of the
+    // first peer (endOfRound, then the metrics reduction) still runs in it, so per round
+    // series keep one entry per round and work that endOfRound starts (e.g. submitting a
+    // request) stops the skip. Peers whose endOfRound neither logs nor starts work in
+    // such a round return false from endOfRoundWhenIdle, and the idle rounds are then
+    // jumped over at once.
+    virtual size_t nextWakeRound() { return RoundManager::currentRound() + 1; }
+    virtual bool endOfRoundWhenIdle() const { return true; }
     
     bool isCrashed() {return (_crashRecoveryRound > RoundManager::currentRound());}
     void setCrashRecoveryRound(size_t crashRecoveryRound) {_crashRecoveryRound = crashRecoveryRound;}
+    size_t crashRecoveryRound() const {return _crashRecoveryRound;}
 
 
     ////////////////// Network Interface direct access ////////////////////
@@ -118,25 +154,39 @@ inline Peer() {}
     NetworkInterface* getNetworkInterface() const { return _networkInterface; };
     interfaceId publicId()   const { return _networkInterface->publicId(); };
     interfaceId internalId() const { return _networkInterface->internalId(); };
-    std::set<interfaceId> neighbors() const { return _networkInterface->neighbors(); };
+    NeighborView neighbors() const { return _networkInterface->neighbors(); };
     void setPublicId(interfaceId pid) { _networkInterface->setPublicId(pid); };
+    void setNeighbors(NeighborView nbrs) { _networkInterface->setNeighbors(nbrs); };
     void addNeighbor(interfaceId nbr) { _networkInterface->addNeighbor(nbr); };
     void removeNeighbor(interfaceId nbr) { _networkInterface->removeNeighbor(nbr); };
 
     // Send messages to to others using these
-    virtual void unicastTo (json msg, const interfaceId& dest) { _networkInterface->unicastTo(msg, dest); };
-    virtual void unicast (json msg) { _networkInterface->unicast(msg); };
-    virtual void multicast (json msg, const std::set<interfaceId>& targets) { _networkInterface->multicast(msg, targets); };
-    virtual void broadcast (json msg) { _networkInterface->broadcast(msg); };
-    virtual void broadcastBut (json msg, const interfaceId& id) { _networkInterface->broadcastBut(msg, id); };
-    virtual void randomMulticast (json msg) { _networkInterface->randomMulticast(msg); };
+    virtual void unicastTo (json msg, const interfaceId& dest) { _networkInterface->unicastTo(std::move(msg), dest); };
+    virtual void unicast (json msg) { _networkInterface->unicast(std::move(msg)); };
+    virtual void multicast (json msg, const std::set<interfaceId>& targets) { _networkInterface->multicast(std::move(msg), targets); };
+    virtual void broadcast (json msg) { _networkInterface->broadcast(std::move(msg)); };
+    virtual void broadcastBut (json msg, const interfaceId& id) { _networkInterface->broadcastBut(std::move(msg), id); };
+    virtual void randomMulticast (json msg) { _networkInterface->randomMulticast(std::move(msg)); };
+
+    // Typed messages (see TypedPayload) go to the network interface directly: faults,
+    // which rewrite json messages, never see them. Check sendsTyped() before using them.
+    bool sendsTyped() const { return _networkInterface->sendsTyped(); }
+    template <typename T>
+    void unicastTyped (T msg, const interfaceId& dest) { _networkInterface->unicastTyped(TypedPayload::make(std::move(msg)), dest); }
+    template <typename T>
+    void multicastTyped (T msg, const std::set<interfaceId>& targets) { _networkInterface->multicastTyped(TypedPayload::make(std::move(msg)), targets); }
+    template <typename T>
+    void broadcastTyped (T msg) { _networkInterface->broadcastTyped(TypedPayload::make(std::move(msg))); }
 
     // Pop from local arrived inStream
     Packet popInStream() { return _networkInterface->popInStream(); };
     bool inStreamEmpty() const { return _networkInterface->inStreamEmpty(); }
+    // take the whole inStream as one batch: for (Packet& packet : drainInStream())
+    PacketQueue& drainInStream() { return _networkInterface->drainInStream(); }
 
     // moves msgs to the inStream if they've arrived
     void receive() { _networkInterface->receive(); };
+    size_t nextArrivalRound() const { return _networkInterface->nextArrivalRound(); }
 
     // Clear everything
     void clearAll() { _networkInterface->clearAll(); };
@@ -0,0 +1,213 @@
+/*
+Copyright 2024
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+QUANTAS is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+//
+// Contiguous storage for the peers of a network and their network interfaces. While
+// a PeerArena::Scope is open on a thread, every Peer and NetworkInterface that thread
+// creates with new is placed in the arena instead of the heap: peers one after the
+// other in one region, their interfaces in another, each object in cache lines of its
+// own. Created in slot order, the peers are then laid out in the order the rounds
+// sweep over them.
+//
+// Deleting an object in the arena runs its destructor and leaves the memory to the
+// arena, which takes it all back at once in reset(), keeps it, and places the next
+// network's peers in it. Every object, in an arena or on the heap, is preceded by a
+// tag saying which, so deleting one never has to look the arenas up. Optionally the
+// memory is backed by transparent huge pages.
+
+#ifndef PeerArena_hpp
+#define PeerArena_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace quantas {
+
+class PeerArena {
+public:
+    enum Kind { Peers = 0, Interfaces = 1 };
+
+    PeerArena() = default;
+    PeerArena(const PeerArena&) = delete;
+    PeerArena& operator=(const PeerArena&) = delete;
+    ~PeerArena() {
+        for (Region& region : _regions) {
+            for (const Chunk& chunk : region.chunks) unmap(chunk);
+        }
+    }
+
+    // back chunks mapped from now on with huge pages (Linux only)
+    void setHugePages(bool hugePages) { _hugePages = hugePages; }
+    // objects of each kind the next network creates, to size the first chunks
+    void expect(size_t count) { _expected = count; }
+
+    inline void* allocate(Kind kind, size_t bytes);
+
+    // every object in the arena is gone; keep the memory for the next network. A region
+    // that had to grow is remapped as one chunk, so the next network is contiguous
+    inline void reset();
+
+    // the arena new places peers in on this thread, nullptr for the heap
+    static PeerArena* current() { return active(); }
+
+    class Scope {
+    private:
+        PeerArena* _previous;
+    public:
+        explicit Scope(PeerArena* arena) : _previous(active()) { active() = arena; }
+        ~Scope() { active() = _previous; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // for operator new and delete of the classes placed in arenas
+    static void* allocateObject(Kind kind, size_t bytes) {
+        PeerArena* arena = current();
+        char* block = static_cast<char*>(arena != nullptr ? arena->allocate(kind, bytes + Header) : ::operator new(bytes + Header));
+        *reinterpret_cast<uint64_t*>(block) = arena != nullptr ? InArena : OnHeap;
+        return block + Header;
+    }
+    static void freeObject(void* p) {
+        if (p == nullptr) return;
+        char* block = static_cast<char*>(p) - Header;
+        if (*reinterpret_cast<const uint64_t*>(block) == OnHeap) ::operator delete(block);
+    }
+
+private:
+    // the tag before each object, sized to keep the object as aligned as new would
+    static constexpr size_t Header = 16;
+    static constexpr uint64_t OnHeap = 0;
+    static constexpr uint64_t InArena = 1;
+    static constexpr size_t Alignment = 64;
+    static constexpr size_t PageSize = size_t(4) << 10;
+    static constexpr size_t HugePageSize = size_t(2) << 20;
+
+    struct Chunk {
+        char* base;
+        size_t size;
+        bool mapped;    // from mmap rather than operator new
+    };
+
+    struct Region {
+        std::vector<Chunk> chunks;
+        size_t chunk = 0;       // chunk being filled
+        size_t used = 0;        // bytes used in it
+        size_t count = 0;       // objects placed since the last reset
+    };
+
+    Region _regions[2];
+    size_t _expected = 1;
+    bool _hugePages = false;
+
+    static PeerArena*& active() {
+        static thread_local PeerArena* arena = nullptr;
+        return arena;
+    }
+
+    static size_t roundUp(size_t value, size_t multiple) {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    inline Chunk map(size_t bytes) const;
+    static inline void unmap(const Chunk& chunk);
+};
+
+inline void* PeerArena::allocate(Kind kind, size_t bytes) {
+    bytes = roundUp(bytes == 0 ? 1 : bytes, Alignment);
+    Region& region = _regions[kind];
+    while (region.chunk < region.chunks.size()) {
+        const Chunk& chunk = region.chunks[region.chunk];
+        if (region.used + bytes <= chunk.size) {
+            void* p = chunk.base + region.used;
+            region.used += bytes;
+            ++region.count;
+            return p;
+        }
+        ++region.chunk;
+        region.used = 0;
+    }
+    // room for the objects still expected, assuming they are the size of this one
+    const size_t remaining = _expected > region.count ? _expected - region.count : 1;
+    region.chunks.push_back(map(bytes * remaining));
+    region.chunk = region.chunks.size() - 1;
+    region.used = bytes;
+    ++region.count;
+    return region.chunks.back().base;
+}
+
+inline void PeerArena::reset() {
+    for (Region& region : _regions) {
+        if (region.chunks.size() > 1) {
+            size_t total = 0;
+            for (const Chunk& chunk : region.chunks) {
+                total += chunk.size;
+                unmap(chunk);
+            }
+            region.chunks.clear();
+            region.chunks.push_back(map(total));
+        }
+        region.chunk = 0;
+        region.used = 0;
+        region.count = 0;
+    }
+}
+
+inline PeerArena::Chunk PeerArena::map(size_t bytes) const {
+    Chunk chunk{nullptr, 0, false};
+#ifdef __linux__
+    const size_t page = _hugePages ? HugePageSize : PageSize;
+    chunk.size = roundUp(bytes, page);
+    // huge pages need an aligned range: map one page more and trim both ends
+    const size_t extra = _hugePages ? HugePageSize : 0;
+    void* p = mmap(nullptr, chunk.size + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) throw std::bad_alloc();
+    char* base = static_cast<char*>(p);
+    if (extra != 0) {
+        char* aligned = reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(base), HugePageSize));
+        if (aligned != base) munmap(base, aligned - base);
+        const size_t tail = (base + chunk.size + extra) - (aligned + chunk.size);
+        if (tail != 0) munmap(aligned + chunk.size, tail);
+        base = aligned;
+        madvise(base, chunk.size, MADV_HUGEPAGE);
+    }
+    chunk.base = base;
+    chunk.mapped = true;
+#else
+    chunk.size = roundUp(bytes, PageSize);
+    chunk.base = static_cast<char*>(::operator new(chunk.size, std::align_val_t(Alignment)));
+#endif
+    return chunk;
+}
+
+inline void PeerArena::unmap(const Chunk& chunk) {
+#ifdef __linux__
+    if (chunk.mapped) {
+        munmap(chunk.base, chunk.size);
+        return;
+    }
+#endif
+    ::operator delete(chunk.base, std::align_val_t(Alignment));
+}
+
+} // namespace quantas
+
+#endif /* PeerArena_hpp */
@@ -1,22 +1,202 @@
 #ifndef RANDOM_UTIL_HPP
 #define RANDOM_UTIL_HPP
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <random>
 #include <thread>
 #include <ctime>
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 
 namespace quantas {
 
 //
-// 1) A single thread_local function that gives us the engine
+// 1) Counter-based random streams
 //
-inline std::mt19937& threadLocalEngine() {
+// A RandomStream is a Philox4x32-10 generator (Salmon et al., "Parallel Random
+// Numbers: As Easy as 1, 2, 3"): block i of a stream is a keyed bijection of the
+// counter (i, peer, channel), so any number of streams can be drawn from in any
+// order, on any thread, and each still yields the same sequence. The key is derived
+// from the experiment seed and the test, the counter from the peer and the channel.
+//
+// Blocks are also computed in batches (fill): Lanes counters side by side,
+// one array per word, so every round of Philox is the same few instructions over all
+// the lanes and the compiler vectorizes it. A batch yields exactly the values the
+// blocks would have one at a time.
+//
+class RandomStream {
+public:
+    using result_type = uint32_t;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT32_MAX; }
+
+    RandomStream() : RandomStream(0, 0, 0, 0) {}
+
+    RandomStream(uint64_t seed, uint32_t test, uint32_t peer, uint32_t channel) {
+        uint64_t key = mix(seed ^ mix(test + 0x9E3779B97F4A7C15ULL));
+        _key = {uint32_t(key), uint32_t(key >> 32)};
+        _peer = peer;
+        _channel = channel;
+    }
+
+    // blocks computed together by fill
+    static constexpr size_t Lanes = 16;
+
+    result_type operator()() {
+        if (_next == _end) {
+            const auto words = block({uint32_t(_block), uint32_t(_block >> 32), _peer, _channel}, _key);
+            std::copy(words.begin(), words.end(), _buffer.begin());
+            ++_block;
+            _next = 0;
+            _end = 4;
+        }
+        return _buffer[_next++];
+    }
+
+    // the next n values, as n calls would return them
+    void fill(uint32_t* out, size_t n) {
+        for (; n > 0 && _next < _end; --n) *out++ = _buffer[_next++];
+        LaneBlocks lanes{};
+        while (n >= 4) {
+            const size_t count = std::min(Lanes, n / 4);
+            for (size_t l = 0; l < count; ++l) lanes.set(l, _block + l, _peer, _channel, _key);
+            lanes.run();
+            for (size_t l = 0; l < count; ++l) out = lanes.get(l, out);
+            _block += count;
+            n -= 4 * count;
+        }
+        for (; n > 0; --n) *out++ = (*this)();
+    }
+
+    // Makes the calling thread draw from stream (threadLocalEngine, uniformInt, ...)
+    // until the scope ends, e.g. while a peer or a channel does its work
+    class Scope {
+    public:
+        explicit Scope(RandomStream& stream) : _previous(current()) { current() = &stream; }
+        ~Scope() { current() = _previous; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        RandomStream* _previous;
+    };
+
+    // stream the calling thread draws from, nullptr outside any scope
+    static RandomStream*& current() {
+        static thread_local RandomStream* stream = nullptr;
+        return stream;
+    }
+
+private:
+    std::array<uint32_t, 2> _key{};
+    uint32_t _peer = 0;
+    uint32_t _channel = 0;
+    uint64_t _block = 0;
+    // values of past blocks not returned yet, _buffer[_next, _end)
+    std::array<uint32_t, 4> _buffer{};
+    uint8_t _next = 0;
+    uint8_t _end = 0;
+
+    // splitmix64 finaliser, spreads nearby seeds and tests over the whole key space
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    static std::array<uint32_t, 4> block(std::array<uint32_t, 4> ctr, std::array<uint32_t, 2> key) {
+        for (int round = 0; round < 10; ++round) {
+            uint64_t p0 = uint64_t(0xD2511F53) * ctr[0];
+            uint64_t p1 = uint64_t(0xCD9E8D57) * ctr[2];
+            ctr = {uint32_t(p1 >> 32) ^ ctr[1] ^ key[0], uint32_t(p1),
+                   uint32_t(p0 >> 32) ^ ctr[3] ^ key[1], uint32_t(p0)};
+            key[0] += 0x9E3779B9;
+            key[1] += 0xBB67AE85;
+        }
+        return ctr;
+    }
+
+    // block() over Lanes counters and keys at once
+    struct LaneBlocks {
+        alignas(64) uint32_t c0[Lanes], c1[Lanes], c2[Lanes], c3[Lanes], k0[Lanes], k1[Lanes];
+
+        void set(size_t l, uint64_t block, uint32_t peer, uint32_t channel, std::array<uint32_t, 2> key) {
+            c0[l] = uint32_t(block);
+            c1[l] = uint32_t(block >> 32);
+            c2[l] = peer;
+            c3[l] = channel;
+            k0[l] = key[0];
+            k1[l] = key[1];
+        }
+        void run() {
+            for (int round = 0; round < 10; ++round) {
+                for (size_t l = 0; l < Lanes; ++l) {
+                    const uint64_t p0 = uint64_t(0xD2511F53) * c0[l];
+                    const uint64_t p1 = uint64_t(0xCD9E8D57) * c2[l];
+                    c0[l] = uint32_t(p1 >> 32) ^ c1[l] ^ k0[l];
+                    c1[l] = uint32_t(p1);
+                    c2[l] = uint32_t(p0 >> 32) ^ c3[l] ^ k1[l];
+                    c3[l] = uint32_t(p0);
+                    k0[l] += 0x9E3779B9;
+                    k1[l] += 0xBB67AE85;
+                }
+            }
+        }
+        uint32_t* get(size_t l, uint32_t* out) const {
+            out[0] = c0[l];
+            out[1] = c1[l];
+            out[2] = c2[l];
+            out[3] = c3[l];
+            return out + 4;
+        }
+    };
+};
+
+//
+// Mapping values of a 32-bit engine to numbers, without building a std distribution
+// per draw. The mapping is ours rather than the standard library's, so a seed gives
+// the same draws whichever library the simulator is built with
+//
+
+// integer in [0, range), Lemire's multiply-shift with rejection (range 0 means 2^32)
+template <typename Engine>
+inline uint32_t boundedInt(Engine& engine, uint32_t range) {
+    if (range == 0) return engine();
+    uint64_t product = uint64_t(engine()) * range;
+    uint32_t low = uint32_t(product);
+    if (low < range) {
+        const uint32_t threshold = -range % range;
+        while (low < threshold) {
+            product = uint64_t(engine()) * range;
+            low = uint32_t(product);
+        }
+    }
+    return uint32_t(product >> 32);
+}
+
+// real in [0, 1) from two values (std::generate_canonical<double, 53>)
+template <typename Engine>
+inline double unitReal(Engine& engine) {
+    double sum = double(engine());
+    sum += double(engine()) * 4294967296.0;
+    const double u = sum / 18446744073709551616.0;
+    return u >= 1.0 ? std::nextafter(1.0, 0.0) : u;
+}
+
+//
+// The engine behind every helper below: the stream of the current scope, or outside
+// of one (e.g. in a standalone tool) a stream seeded per thread from the time.
+//
+inline RandomStream& threadLocalEngine() {
+    if (RandomStream* stream = RandomStream::current()) {
+        return *stream;
+    }
     // We combine the time and the hashed thread ID to get a seed unique to each thread
-    static thread_local std::mt19937 engine(
-        static_cast<unsigned>(std::time(nullptr))
-        + static_cast<unsigned>(std::hash<std::thread::id>{}(std::this_thread::get_id()))
+    static thread_local RandomStream engine(
+        static_cast<uint64_t>(std::time(nullptr))
+        + static_cast<uint64_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())), 0, 0, 0
     );
     return engine;
 }
@@ -28,8 +208,8 @@ inline int uniformInt(int minVal, int maxVal) {
     if (minVal > maxVal) {
         throw std::invalid_argument("uniformInt: minVal > maxVal");
     }
-    std::uniform_int_distribution<int> dist(minVal, maxVal);
-    return dist(threadLocalEngine());
+    const uint32_t range = uint32_t(maxVal) - uint32_t(minVal) + 1;
+    return int(uint32_t(minVal) + boundedInt(threadLocalEngine(), range));
 }
 
 //
@@ -39,8 +219,7 @@ inline double uniformReal(double minVal, double maxVal) {
     if (minVal > maxVal) {
         throw std::invalid_argument("uniformReal: minVal > maxVal");
     }
-    std::uniform_real_distribution<double> dist(minVal, maxVal);
-    return dist(threadLocalEngine());
+    return unitReal(threadLocalEngine()) * (maxVal - minVal) + minVal;
 }
 
 //
@@ -79,6 +258,23 @@ inline int poissonInt(double lambda) {
     return dist(threadLocalEngine());
 }
 
+//
+// geometricInt(p) -> number of failed trials before the first success of a
+// trial that succeeds with probability p (i.e. rounds to wait for an event)
+//
+inline int geometricInt(double p) {
+    if (p <= 0.0 || p > 1.0) {
+        throw std::invalid_argument(
+            "geometricInt: probability must be in (0, 1], received: " + std::to_string(p)
+        );
+    }
+    if (p == 1.0) {
+        return 0;
+    }
+    std::geometric_distribution<int> dist(p);
+    return dist(threadLocalEngine());
+}
+
 } // namespace quantas
 
 #endif // RANDOM_UTIL_HPP
\ No newline at end of file
@@ -20,9 +20,13 @@ along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
 #define RoundManager_hpp
 
 #include <chrono>
+#include <limits>
 
 namespace quantas {
 
+// used to indicate that no round is scheduled (e.g. a peer that is waiting only on messages)
+inline static const size_t NO_ROUND = std::numeric_limits<size_t>::max();
+
 class RoundManager {
 private:
     size_t _currentRound{0};
@@ -30,19 +34,31 @@ private:
     bool _synchronous{true};
     std::chrono::steady_clock::time_point _start_time;
 
-    // Private constructor and copy operations to enforce singleton usage:
-    RoundManager() {
-        _start_time = std::chrono::steady_clock::now();
-    };
+    // round manager bound to the calling thread, if any (see bind)
+    static RoundManager*& bound() {
+        static thread_local RoundManager* b = nullptr;
+        return b;
+    }
+
     RoundManager(const RoundManager&) = delete;
     RoundManager& operator=(const RoundManager&) = delete;
 
 public:
+    // Normally the process wide instance is used; separate instances exist only so
+    // concurrently running tests each have their own clock (see bind).
+    RoundManager() {
+        _start_time = std::chrono::steady_clock::now();
+    };
+
     static RoundManager* instance() {
+        if (bound() != nullptr) return bound();
         static RoundManager s;
         return &s;
     }
 
+    // Make instance() return rm on the calling thread (nullptr restores the process wide one)
+    static void bind(RoundManager* rm) { bound() = rm; }
+
     static size_t currentRound() { 
         RoundManager* inst = instance();
         if (inst->_synchronous) {
@@ -0,0 +1,80 @@
+/*
+Copyright 2024
+
+This file is part of QUANTAS.
+QUANTAS is free software: you can redistribute it and/or modify it
+under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+QUANTAS is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with QUANTAS. If not, see <https://www.gnu.org/licenses/>.
+*/
+//
+// An unbounded queue between exactly one producer thread and one consumer thread,
+// without locks. Values travel in a linked list of nodes: the producer links a new
+// node after the last one and the consumer follows the links, each touching only its
+// own end, so the single atomic link between them is all that is shared. The consumer
+// always keeps the last node it took as the head of the list.
+
+#ifndef SpscQueue_hpp
+#define SpscQueue_hpp
+
+#include <atomic>
+#include <utility>
+
+namespace quantas {
+
+template <typename T>
+class SpscQueue {
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value{};
+    };
+
+    alignas(64) Node* _head;    // consumer side: the node taken last
+    alignas(64) Node* _tail;    // producer side: the node linked last
+
+public:
+    SpscQueue() : _head(new Node), _tail(_head) {}
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+    ~SpscQueue() {
+        while (_head != nullptr) {
+            Node* next = _head->next.load(std::memory_order_relaxed);
+            delete _head;
+            _head = next;
+        }
+    }
+
+    // producer only
+    void push(T value) {
+        Node* node = new Node;
+        node->value = std::move(value);
+        _tail->next.store(node, std::memory_order_release);
+        _tail = node;
+    }
+
+    // consumer only; false if nothing has been pushed since the last pop
+    bool pop(T& out) {
+        Node* next = _head->next.load(std::memory_order_acquire);
+        if (next == nullptr) return false;
+        out = std::move(next->value);
+        delete _head;
+        _head = next;
+        return true;
+    }
+
+    // consumer only
+    bool empty() const { return _head->next.load(std::memory_order_acquire) == nullptr; }
+};
+
+} // namespace quantas
+
+#endif /* SpscQueue_hpp */
@@ -34,5 +34,16 @@ size_t getPeakMemoryKB() {
     #endif
 }
 
+// Heap allocations made by the process so far (operator new calls). Only builds made
+// with COUNT_ALLOCATIONS=1 count them (Abstract/allocationCounter.cpp replaces the
+// global operator new); see "reportAllocations".
+#ifdef QUANTAS_COUNT_ALLOCATIONS
+constexpr bool AllocationsCounted = true;
+size_t allocationCount();
+#else
+constexpr bool AllocationsCounted = false;
+inline size_t allocationCount() { return 0; }
+#endif
+
 #endif /* MEMORY_HPP */
 
@@ -431,12 +431,13 @@ void EthereumPeer::checkInStrm() {
 
     while (!inStreamEmpty()) {
         Packet packet = popInStream();
-        json msg = packet.getMessage();
+        // read in place: the payload may be shared with the rest of a broadcast
+        const json& msg = packet.getMessage();
         if (!msg.contains("type") || msg["type"] != "PoW") continue;
 
         const std::string messageType = msg.value("messageType", std::string());
         if (messageType == "transaction") {
-            const json& txJson = msg["transaction"];
+            const json& txJson = msg.at("transaction");
             int txId = txJson.value("id", -1);
             interfaceId submitter = txJson.value("submitter", msg.value("from_id", NO_PEER_ID));
             if (txId < 0 || submitter == NO_PEER_ID) continue;
@@ -449,7 +450,7 @@ void EthereumPeer::checkInStrm() {
                 _queue.push_back(pending);
             }
         } else if (messageType == "block") {
-            const json& blkJson = msg["block"];
+            const json& blkJson = msg.at("block");
             std::string hash = blkJson.value("hash", std::string());
 
             std::vector<std::string> parents;
@@ -108,7 +108,7 @@ void ExamplePeer::checkInStrm() {
 }
 
 void ExamplePeer::logInboundMessage(const Packet& packet) const {
-    json payload = packet.getMessage();
+    const json& payload = packet.getMessage();
     json logEntry;
     logEntry["to"] = publicId();
     interfaceId sender = packet.sourceId();
@@ -81,7 +81,7 @@ void ExamplePeer2::checkInStrm() {
 }
 
 void ExamplePeer2::logInboundMessage(const Packet& packet) const {
-    json payload = packet.getMessage();
+    const json& payload = packet.getMessage();
     json logEntry;
     logEntry["to"] = publicId();
     interfaceId sender = packet.sourceId();
@@ -41,10 +41,6 @@ static bool registerKademliaConcrete = []() {
         [](interfaceId /*pubId*/) { return new KademliaPeer(new NetworkInterfaceConcrete()); });
 }();
 
-int KademliaPeer::s_currentTransactionId = 1;
-std::vector<interfaceId> KademliaPeer::s_allPeerIds;
-int KademliaPeer::s_binaryIdSize = 1;
-
 KademliaPeer::~KademliaPeer() = default;
 
 KademliaPeer::KademliaPeer(const KademliaPeer& rhs)
@@ -58,45 +54,54 @@ KademliaPeer::KademliaPeer(const KademliaPeer& rhs)
       _totalHops(rhs._totalHops),
       _latency(rhs._latency),
       _alive(rhs._alive),
-      _initialized(rhs._initialized) {}
+      _initialized(rhs._initialized),
+      _typedMessages(rhs._typedMessages) {}
 
 KademliaPeer::KademliaPeer(NetworkInterface* networkInterface)
     : Peer(networkInterface) {}
 
-void KademliaPeer::initParameters(const std::vector<Peer*>& peers, json /*parameters*/) {
-    s_allPeerIds.clear();
-    s_allPeerIds.reserve(peers.size());
+void KademliaPeer::initParameters(const std::vector<Peer*>& peers, json parameters) {
+    auto allPeerIds = std::make_shared<std::vector<interfaceId>>();
+    allPeerIds->reserve(peers.size());
     for (const auto* base : peers) {
-        s_allPeerIds.push_back(base->publicId());
+        allPeerIds->push_back(base->publicId());
     }
 
-    size_t peerCount = std::max<size_t>(1, s_allPeerIds.size());
-    s_binaryIdSize = static_cast<int>(std::ceil(std::log2(static_cast<double>(peerCount))));
-    if (s_binaryIdSize <= 0) s_binaryIdSize = 1;
+    size_t peerCount = std::max<size_t>(1, allPeerIds->size());
+    int binaryIdSize = static_cast<int>(std::ceil(std::log2(static_cast<double>(peerCount))));
+    if (binaryIdSize <= 0) binaryIdSize = 1;
 
     const int maxBits = static_cast<int>(sizeof(std::uint64_t) * 8);
-    if (s_binaryIdSize > maxBits) {
-        s_binaryIdSize = maxBits;
+    if (binaryIdSize > maxBits) {
+        binaryIdSize = maxBits;
     }
 
+    const bool typedMessages = parameters.is_object() && parameters.value("typedMessages", false);
+    std::shared_ptr<const std::vector<interfaceId>> sharedIds = std::move(allPeerIds);
     for (auto* base : peers) {
         auto* peer = static_cast<KademliaPeer*>(base);
-        peer->applyGlobalParameters();
-        peer->_requestsSatisfied = 0;
-        peer->_totalHops = 0;
-        peer->_latency = 0;
-        peer->_fingers.clear();
-        peer->_lastNeighborFingerprint = 0;
+        peer->_allPeerIds = sharedIds;
+        peer->_binaryIdSize = binaryIdSize;
+        peer->_typedMessages = typedMessages && peer->sendsTyped();
     }
 }
 
+void KademliaPeer::initPeer(const json& /*parameters*/) {
+    _binaryId = getBinaryId(publicId());
+    _initialized = !_allPeerIds->empty();
+    _requestsSatisfied = 0;
+    _totalHops = 0;
+    _latency = 0;
+    _fingers.clear();
+    _lastNeighborFingerprint = 0;
+}
+
 void KademliaPeer::performComputation() {
     if (!_alive) return;
 
-    ensureInitialized();
     if (!_initialized) return;
 
-    const std::set<interfaceId> neighborSet = neighbors();
+    const NeighborView neighborSet = neighbors();
     const size_t fingerprint = neighborFingerprint(neighborSet);
     if (_fingers.empty() || fingerprint != _lastNeighborFingerprint) {
         rebuildFingerTable(neighborSet);
@@ -105,17 +110,32 @@ void KademliaPeer::performComputation() {
     checkInStrm();
 }
 
+size_t KademliaPeer::nextWakeRound() {
+    // lookups are started from endOfRound, which fast-forward still runs in the rounds
+    // it skips, and then only move on messages
+    return NO_ROUND;
+}
+
 void KademliaPeer::checkInStrm() {
-    while (!inStreamEmpty()) {
-        Packet packet = popInStream();
-        json message = packet.getMessage();
+    for (Packet& packet : drainInStream()) {
+        if (const KademliaLookup* lookup = packet.as<KademliaLookup>()) {
+            handleLookup(*lookup);
+            continue;
+        }
+        json message = packet.takeMessage();
         if (!message.is_object()) continue;
-        if (message.value("type", std::string()) != "Kademlia") continue;
-        if (message.value("messageType", std::string()) != "lookup") continue;
-        handleLookup(std::move(message));
+        auto type = message.find("type");
+        if (type == message.end() || *type != "Kademlia") continue;
+        if (auto handler = s_messages.find(message, "messageType")) {
+            (this->*handler)(std::move(message));
+        }
     }
 }
 
+const MessageTable<void (KademliaPeer::*)(json)> KademliaPeer::s_messages = {
+    {"lookup", &KademliaPeer::handleLookup}
+};
+
 void KademliaPeer::handleLookup(json msg) {
     interfaceId targetId = msg.value("targetId", NO_PEER_ID);
     if (targetId == NO_PEER_ID) return;
@@ -128,7 +148,7 @@ void KademliaPeer::handleLookup(json msg) {
         return;
     }
 
-    const std::set<interfaceId> neighborSet = neighbors();
+    const NeighborView neighborSet = neighbors();
     if (neighborSet.empty()) return;
 
     std::string targetBinary = msg.value("targetBinaryId", std::string());
@@ -147,29 +167,64 @@ void KademliaPeer::handleLookup(json msg) {
     unicastTo(std::move(msg), nextHop);
 }
 
+// the typed twin of the above
+void KademliaPeer::handleLookup(KademliaLookup lookup) {
+    if (lookup.targetId == publicId()) {
+        ++_requestsSatisfied;
+        _totalHops += lookup.hops;
+        _latency += static_cast<int>(RoundManager::currentRound()) - lookup.roundSubmitted;
+        return;
+    }
+
+    const NeighborView neighborSet = neighbors();
+    if (neighborSet.empty()) return;
+
+    interfaceId nextHop = findRoute(lookup.targetBinaryId, lookup.targetId, neighborSet);
+    if (nextHop == NO_PEER_ID || nextHop == publicId()) {
+        return;
+    }
+
+    ++lookup.hops;
+    lookup.lastHop = publicId();
+    unicastTyped(std::move(lookup), nextHop);
+}
+
 void KademliaPeer::submitLookup(int transactionId) {
     if (!_initialized) return;
 
     interfaceId targetId = publicId();
-    if (!_allPeerIds.empty()) {
-        int index = randMod(static_cast<int>(_allPeerIds.size()));
-        targetId = _allPeerIds[static_cast<size_t>(index)];
+    if (!_allPeerIds->empty()) {
+        int index = randMod(static_cast<int>(_allPeerIds->size()));
+        targetId = (*_allPeerIds)[static_cast<size_t>(index)];
     }
 
     std::string targetBinary = getBinaryId(targetId);
-    json msg = makeLookupMessage(targetId, targetBinary, transactionId);
 
     if (targetId == publicId()) {
         ++_requestsSatisfied;
         return;
     }
 
-    const std::set<interfaceId> neighborSet = neighbors();
+    const NeighborView neighborSet = neighbors();
     if (neighborSet.empty()) return;
 
     interfaceId nextHop = findRoute(targetBinary, targetId, neighborSet);
     if (nextHop == NO_PEER_ID || nextHop == publicId()) return;
 
+    if (_typedMessages) {
+        KademliaLookup lookup;
+        lookup.transactionId = transactionId;
+        lookup.originId = publicId();
+        lookup.targetId = targetId;
+        lookup.targetBinaryId = std::move(targetBinary);
+        lookup.roundSubmitted = static_cast<int>(RoundManager::currentRound());
+        lookup.hops = 1;
+        lookup.lastHop = publicId();
+        unicastTyped(std::move(lookup), nextHop);
+        return;
+    }
+
+    json msg = makeLookupMessage(targetId, targetBinary, transactionId);
     msg["hops"] = msg.value("hops", 0) + 1;
     msg["lastHop"] = publicId();
     unicastTo(std::move(msg), nextHop);
@@ -191,28 +246,6 @@ json KademliaPeer::makeLookupMessage(interfaceId targetId,
     return msg;
 }
 
-void KademliaPeer::applyGlobalParameters() {
-    if (s_binaryIdSize <= 0 || s_allPeerIds.empty()) return;
-    _binaryIdSize = s_binaryIdSize;
-    _allPeerIds = s_allPeerIds;
-    _binaryId = getBinaryId(publicId());
-    _initialized = true;
-}
-
-void KademliaPeer::ensureInitialized() {
-    if (!_initialized) {
-        applyGlobalParameters();
-    } else {
-        if (s_binaryIdSize > 0 && _binaryIdSize != s_binaryIdSize) {
-            _binaryIdSize = s_binaryIdSize;
-            _binaryId = getBinaryId(publicId());
-        }
-        if (!s_allPeerIds.empty()) {
-            _allPeerIds = s_allPeerIds;
-        }
-    }
-}
-
 std::string KademliaPeer::getBinaryId(interfaceId id) const {
     if (_binaryIdSize <= 0) return std::string();
     std::string result;
@@ -231,7 +264,7 @@ std::string KademliaPeer::getBinaryId(interfaceId id) const {
 
 interfaceId KademliaPeer::findRoute(const std::string& targetBinaryId,
                                     interfaceId targetId,
-                                    const std::set<interfaceId>& neighborSet) const {
+                                    NeighborView neighborSet) const {
     if (targetBinaryId.empty() || _binaryId.empty()) {
         return selectClosestByDistance(targetId, neighborSet);
     }
@@ -250,7 +283,7 @@ interfaceId KademliaPeer::findRoute(const std::string& targetBinaryId,
 }
 
 interfaceId KademliaPeer::selectFingerForGroup(int group,
-                                               const std::set<interfaceId>& neighborSet) const {
+                                               NeighborView neighborSet) const {
     std::vector<interfaceId> candidates;
     for (const auto& finger : _fingers) {
         if (finger.group != group) continue;
@@ -266,7 +299,7 @@ interfaceId KademliaPeer::selectFingerForGroup(int group,
 }
 
 interfaceId KademliaPeer::selectClosestByDistance(interfaceId targetId,
-                                                  const std::set<interfaceId>& neighborSet) const {
+                                                  NeighborView neighborSet) const {
     std::uint64_t selfDistance = xorDistance(publicId(), targetId);
     std::uint64_t bestDistance = selfDistance;
     interfaceId best = NO_PEER_ID;
@@ -293,7 +326,7 @@ int KademliaPeer::firstDifferentBit(const std::string& lhs, const std::string& r
     return -1;
 }
 
-void KademliaPeer::rebuildFingerTable(const std::set<interfaceId>& neighborSet) {
+void KademliaPeer::rebuildFingerTable(NeighborView neighborSet) {
     _fingers.clear();
     if (_binaryIdSize <= 0) {
         _lastNeighborFingerprint = neighborFingerprint(neighborSet);
@@ -325,7 +358,7 @@ void KademliaPeer::rebuildFingerTable(const std::set<interfaceId>& neighborSet)
     _lastNeighborFingerprint = neighborFingerprint(neighborSet);
 }
 
-size_t KademliaPeer::neighborFingerprint(const std::set<interfaceId>& neighborSet) const {
+size_t KademliaPeer::neighborFingerprint(NeighborView neighborSet) const {
     size_t hash = neighborSet.size();
     const size_t magic = static_cast<size_t>(0x9e3779b97f4a7c15ULL);
     for (interfaceId id : neighborSet) {
@@ -337,33 +370,25 @@ size_t KademliaPeer::neighborFingerprint(const std::set<interfaceId>& neighborSe
 void KademliaPeer::endOfRound(std::vector<Peer*>& peers) {
     if (peers.empty()) return;
 
-    std::vector<KademliaPeer*> typed;
-    typed.reserve(peers.size());
-    for (auto* base : peers) {
-        typed.push_back(static_cast<KademliaPeer*>(base));
-    }
-
-    if (!typed.empty()) {
-        int index = randMod(static_cast<int>(typed.size()));
-        typed[static_cast<size_t>(index)]->submitLookup(s_currentTransactionId++);
-    }
-
-    long long satisfied = 0;
-    long long hops = 0;
-    long long latency = 0;
+    // metrics are summed in collectMetrics, here only the next lookup is started
+    int index = randMod(static_cast<int>(peers.size()));
+    static_cast<KademliaPeer*>(peers[static_cast<size_t>(index)])->submitLookup(_nextTransactionId++);
+}
 
-    for (auto* peer : typed) {
-        satisfied += peer->_requestsSatisfied;
-        hops += peer->_totalHops;
-        latency += peer->_latency;
-    }
+void KademliaPeer::collectMetrics(MetricReducer& metrics) {
+    metrics.sum("satisfied", _requestsSatisfied);
+    metrics.sum("hops", _totalHops);
+    metrics.sum("latency", _latency);
+}
 
+void KademliaPeer::reportMetrics(const MetricReducer& metrics, std::vector<Peer*>& peers) {
+    const double satisfied = metrics.get("satisfied");
     if (satisfied > 0) {
-        const double avgHops = static_cast<double>(hops) / satisfied;
+        const double avgHops = metrics.get("hops") / satisfied;
         LogWriter::pushValue("kademliaAverageHops", avgHops);
-        LogWriter::pushValue("kademliaAverageLatency", static_cast<double>(latency) / satisfied);
+        LogWriter::pushValue("kademliaAverageLatency", metrics.get("latency") / satisfied);
     }
-    LogWriter::pushValue("kademliaRequestsSatisfied", static_cast<double>(satisfied));
+    LogWriter::pushValue("kademliaRequestsSatisfied", satisfied);
 }
 
 }  // namespace quantas
@@ -11,10 +11,12 @@ You should have received a copy of the GNU General Public License along with QUA
 #define KademliaPeer_hpp
 
 #include <set>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "../Common/Json.hpp"
+#include "../Common/MessageTypes.hpp"
 #include "../Common/Peer.hpp"
 
 namespace quantas {
@@ -25,6 +27,17 @@ struct KademliaFinger {
     int group{-1};                  // the level the finger belongs to (binary id difference)
 };
 
+// a lookup as a typed message ("typedMessages"), with the fields of makeLookupMessage
+struct KademliaLookup {
+    int transactionId{0};
+    interfaceId originId{NO_PEER_ID};
+    interfaceId targetId{NO_PEER_ID};
+    std::string targetBinaryId;
+    int roundSubmitted{0};
+    int hops{0};
+    interfaceId lastHop{NO_PEER_ID};
+};
+
 class KademliaPeer : public Peer {
 public:
     KademliaPeer(NetworkInterface*);
@@ -33,39 +46,46 @@ public:
 
     void initParameters(const std::vector<Peer*>& peers, json parameters) override;
     void performComputation() override;
+    void initPeer(const json& parameters) override;
     void endOfRound(std::vector<Peer*>& peers) override;
+    bool reducesMetrics() const override { return true; }
+    void collectMetrics(MetricReducer& metrics) override;
+    void reportMetrics(const MetricReducer& metrics, std::vector<Peer*>& peers) override;
+    size_t nextWakeRound() override;
 
 private:
     // high-level workflow
     void checkInStrm();
+    // the json messages, by "messageType"
+    static const MessageTable<void (KademliaPeer::*)(json)> s_messages;
     void handleLookup(json msg);
+    void handleLookup(KademliaLookup lookup);
     void submitLookup(int transactionId);
 
     // helpers
-    void applyGlobalParameters();
-    void ensureInitialized();
     std::string getBinaryId(interfaceId id) const;
     interfaceId findRoute(const std::string& targetBinaryId,
                           interfaceId targetId,
-                          const std::set<interfaceId>& neighborSet) const;
+                          NeighborView neighborSet) const;
     interfaceId selectFingerForGroup(int group,
-                                     const std::set<interfaceId>& neighborSet) const;
+                                     NeighborView neighborSet) const;
     interfaceId selectClosestByDistance(interfaceId targetId,
-                                        const std::set<interfaceId>& neighborSet) const;
+                                        NeighborView neighborSet) const;
     static int firstDifferentBit(const std::string& lhs, const std::string& rhs);
-    void rebuildFingerTable(const std::set<interfaceId>& neighborSet);
-    size_t neighborFingerprint(const std::set<interfaceId>& neighborSet) const;
+    void rebuildFingerTable(NeighborView neighborSet);
+    size_t neighborFingerprint(NeighborView neighborSet) const;
     json makeLookupMessage(interfaceId targetId,
                            const std::string& targetBinaryId,
                            int transactionId) const;
 
-    static int s_currentTransactionId;
-    static std::vector<interfaceId> s_allPeerIds;
-    static int s_binaryIdSize;
+    // id of the next lookup endOfRound starts: only the first peer's is used, so it
+    // starts over with every test
+    int _nextTransactionId{1};
 
     int _binaryIdSize{0};
     std::string _binaryId{""};
-    std::vector<interfaceId> _allPeerIds;
+    // ids of every peer, built once in initParameters and shared
+    std::shared_ptr<const std::vector<interfaceId>> _allPeerIds = std::make_shared<const std::vector<interfaceId>>();
     std::vector<KademliaFinger> _fingers;
     size_t _lastNeighborFingerprint{0};
 
@@ -74,6 +94,7 @@ private:
     int _latency{0};
     bool _alive{true};
     bool _initialized{false};
+    bool _typedMessages{false};  // send lookups typed
 };
 }
 #endif /* KademliaPeer_hpp */
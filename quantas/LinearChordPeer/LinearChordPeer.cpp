@@ -27,8 +27,6 @@ static bool registerLinearChordPeer = []() {
         [](interfaceId pubId) { return new LinearChordPeer(new NetworkInterfaceAbstract(pubId)); });
 }();
 
-int LinearChordPeer::s_nextTransactionId = 1;
-
 LinearChordPeer::LinearChordPeer(NetworkInterface* interfacePtr)
     : Peer(interfacePtr) {}
 
@@ -51,25 +49,29 @@ void LinearChordPeer::initParameters(const std::vector<Peer*>& peers, json /*par
     }
     std::sort(ringOrder.begin(), ringOrder.end());
 
-    std::unordered_map<interfaceId, size_t> indexById;
+    auto indexById = std::make_shared<std::unordered_map<interfaceId, size_t>>();
     for (size_t idx = 0; idx < ringOrder.size(); ++idx) {
-        indexById[ringOrder[idx]] = idx;
+        (*indexById)[ringOrder[idx]] = idx;
     }
 
+    auto sharedOrder = std::make_shared<const std::vector<interfaceId>>(std::move(ringOrder));
     for (auto* basePtr : peers) {
         auto* peerPtr = static_cast<LinearChordPeer*>(basePtr);
-        peerPtr->_ringOrder = ringOrder;
+        peerPtr->_ringOrder = sharedOrder;
         peerPtr->_indexById = indexById;
-        auto it = indexById.find(peerPtr->publicId());
-        peerPtr->_selfIndex = (it != indexById.end()) ? it->second : 0;
-        peerPtr->_requestsSatisfied = 0;
-        peerPtr->_totalHops = 0;
-        peerPtr->_totalLatency = 0;
-        peerPtr->_initialized = true;
-        peerPtr->buildFingerTable();
     }
 }
 
+void LinearChordPeer::initPeer(const json& /*parameters*/) {
+    auto it = _indexById->find(publicId());
+    _selfIndex = (it != _indexById->end()) ? it->second : 0;
+    _requestsSatisfied = 0;
+    _totalHops = 0;
+    _totalLatency = 0;
+    _initialized = true;
+    buildFingerTable();
+}
+
 void LinearChordPeer::performComputation() {
     if (!_initialized) return;
     checkInStrm();
@@ -78,7 +80,7 @@ void LinearChordPeer::performComputation() {
 void LinearChordPeer::checkInStrm() {
     while (!inStreamEmpty()) {
         Packet packet = popInStream();
-        json msg = packet.getMessage();
+        json msg = packet.takeMessage();
         if (!msg.contains("type") || msg["type"] != "LinearChord") continue;
         const std::string messageType = msg.value("messageType", std::string());
         if (messageType == "lookup") {
@@ -99,7 +101,7 @@ void LinearChordPeer::handleLookup(json msg) {
         return;
     }
 
-    const std::set<interfaceId> neighborSet = neighbors();
+    const NeighborView neighborSet = neighbors();
     interfaceId nextHop = selectFinger(target, neighborSet);
     if (nextHop == NO_PEER_ID) {
         nextHop = chooseClockwiseNeighbor(target, neighborSet);
@@ -110,7 +112,7 @@ void LinearChordPeer::handleLookup(json msg) {
 }
 
 void LinearChordPeer::submitLookup(int transactionId) {
-    if (!_initialized || _ringOrder.empty()) return;
+    if (!_initialized || _ringOrder->empty()) return;
 
     interfaceId target = pickRandomTarget();
     json msg = makeLookupTemplate(target, transactionId);
@@ -119,7 +121,7 @@ void LinearChordPeer::submitLookup(int transactionId) {
         return;
     }
 
-    const std::set<interfaceId> neighborSet = neighbors();
+    const NeighborView neighborSet = neighbors();
     interfaceId nextHop = selectFinger(target, neighborSet);
     if (nextHop == NO_PEER_ID) {
         nextHop = chooseClockwiseNeighbor(target, neighborSet);
@@ -143,22 +145,22 @@ json LinearChordPeer::makeLookupTemplate(interfaceId target, int transactionId)
 }
 
 interfaceId LinearChordPeer::pickRandomTarget() const {
-    if (_ringOrder.empty()) return publicId();
-    int index = randMod(static_cast<int>(_ringOrder.size()));
-    interfaceId candidate = _ringOrder[static_cast<size_t>(index)];
-    if (candidate == publicId() && _ringOrder.size() > 1) {
-        size_t nextIndex = (static_cast<size_t>(index) + 1) % _ringOrder.size();
-        candidate = _ringOrder[nextIndex];
+    if (_ringOrder->empty()) return publicId();
+    int index = randMod(static_cast<int>(_ringOrder->size()));
+    interfaceId candidate = (*_ringOrder)[static_cast<size_t>(index)];
+    if (candidate == publicId() && _ringOrder->size() > 1) {
+        size_t nextIndex = (static_cast<size_t>(index) + 1) % _ringOrder->size();
+        candidate = (*_ringOrder)[nextIndex];
     }
     return candidate;
 }
 
-interfaceId LinearChordPeer::selectFinger(interfaceId target, const std::set<interfaceId>& neighborSet) const {
-    const size_t ringSize = _ringOrder.size();
+interfaceId LinearChordPeer::selectFinger(interfaceId target, NeighborView neighborSet) const {
+    const size_t ringSize = _ringOrder->size();
     if (ringSize <= 1) return NO_PEER_ID;
 
-    auto targetIt = _indexById.find(target);
-    if (targetIt == _indexById.end()) return NO_PEER_ID;
+    auto targetIt = _indexById->find(target);
+    if (targetIt == _indexById->end()) return NO_PEER_ID;
     size_t distanceToTarget = (targetIt->second + ringSize - _selfIndex) % ringSize;
     if (distanceToTarget == 0) return NO_PEER_ID;
 
@@ -178,12 +180,12 @@ interfaceId LinearChordPeer::selectFinger(interfaceId target, const std::set<int
 }
 
 interfaceId LinearChordPeer::chooseClockwiseNeighbor(interfaceId target,
-                                                        const std::set<interfaceId>& neighborSet) const {
-    const size_t ringSize = _ringOrder.size();
+                                                        NeighborView neighborSet) const {
+    const size_t ringSize = _ringOrder->size();
     if (ringSize <= 1 || neighborSet.empty()) return NO_PEER_ID;
 
-    auto targetIt = _indexById.find(target);
-    if (targetIt == _indexById.end()) return NO_PEER_ID;
+    auto targetIt = _indexById->find(target);
+    if (targetIt == _indexById->end()) return NO_PEER_ID;
     size_t targetDistance = (targetIt->second + ringSize - _selfIndex) % ringSize;
     if (targetDistance == 0) return NO_PEER_ID;
 
@@ -191,8 +193,8 @@ interfaceId LinearChordPeer::chooseClockwiseNeighbor(interfaceId target,
     size_t bestDistance = ringSize;
 
     for (interfaceId neighbor : neighborSet) {
-        auto it = _indexById.find(neighbor);
-        if (it == _indexById.end()) continue;
+        auto it = _indexById->find(neighbor);
+        if (it == _indexById->end()) continue;
         size_t distance = (it->second + ringSize - _selfIndex) % ringSize;
         if (distance == 0) continue;
         if (distance <= targetDistance && distance < bestDistance) {
@@ -203,8 +205,8 @@ interfaceId LinearChordPeer::chooseClockwiseNeighbor(interfaceId target,
     if (best != NO_PEER_ID) return best;
 
     for (interfaceId neighbor : neighborSet) {
-        auto it = _indexById.find(neighbor);
-        if (it == _indexById.end()) continue;
+        auto it = _indexById->find(neighbor);
+        if (it == _indexById->end()) continue;
         size_t distance = (it->second + ringSize - _selfIndex) % ringSize;
         if (distance == 0) continue;
         if (distance < bestDistance) {
@@ -217,7 +219,7 @@ interfaceId LinearChordPeer::chooseClockwiseNeighbor(interfaceId target,
 
 void LinearChordPeer::dispatchLookup(json msg,
                                         interfaceId nextHop,
-                                        const std::set<interfaceId>& neighborSet) {
+                                        NeighborView neighborSet) {
     if (nextHop == NO_PEER_ID || nextHop == publicId()) return;
     if (!neighborSet.count(nextHop)) return;
     msg["hops"] = msg.value("hops", 0) + 1;
@@ -227,7 +229,7 @@ void LinearChordPeer::dispatchLookup(json msg,
 
 void LinearChordPeer::buildFingerTable() {
     _fingers.clear();
-    const size_t ringSize = _ringOrder.size();
+    const size_t ringSize = _ringOrder->size();
     if (ringSize <= 1) return;
 
     size_t maxSkip = ringSize - 1;
@@ -241,7 +243,7 @@ void LinearChordPeer::buildFingerTable() {
         size_t normalized = skip % ringSize;
         if (normalized == 0) continue;
         size_t idx = (_selfIndex + skip) % ringSize;
-        interfaceId nodeId = _ringOrder[idx];
+        interfaceId nodeId = (*_ringOrder)[idx];
         if (nodeId == publicId()) continue;
         if (!_fingers.empty() && _fingers.back().nodeId == nodeId) continue;
         FingerEntry entry;
@@ -256,32 +258,24 @@ void LinearChordPeer::buildFingerTable() {
 void LinearChordPeer::endOfRound(std::vector<Peer*>& peers) {
     if (peers.empty()) return;
 
-    std::vector<LinearChordPeer*> typed;
-    typed.reserve(peers.size());
-    for (auto* basePtr : peers) {
-        typed.push_back(static_cast<LinearChordPeer*>(basePtr));
-    }
-
-    if (!typed.empty()) {
-        int idx = randMod(static_cast<int>(typed.size()));
-        typed[static_cast<size_t>(idx)]->submitLookup(s_nextTransactionId++);
-    }
-
-    long long totalSatisfied = 0;
-    long long totalHops = 0;
-    long long totalLatency = 0;
+    // metrics are summed in collectMetrics, here only the next lookup is started
+    int idx = randMod(static_cast<int>(peers.size()));
+    static_cast<LinearChordPeer*>(peers[static_cast<size_t>(idx)])->submitLookup(_nextTransactionId++);
+}
 
-    for (auto* peerPtr : typed) {
-        totalSatisfied += peerPtr->_requestsSatisfied;
-        totalHops += peerPtr->_totalHops;
-        totalLatency += peerPtr->_totalLatency;
-    }
+void LinearChordPeer::collectMetrics(MetricReducer& metrics) {
+    metrics.sum("satisfied", _requestsSatisfied);
+    metrics.sum("hops", _totalHops);
+    metrics.sum("latency", _totalLatency);
+}
 
+void LinearChordPeer::reportMetrics(const MetricReducer& metrics, std::vector<Peer*>& peers) {
+    const double totalSatisfied = metrics.get("satisfied");
     if (totalSatisfied > 0) {
-        LogWriter::pushValue("linearChordAverageHops", static_cast<double>(totalHops) / totalSatisfied);
-        LogWriter::pushValue("linearChordAverageLatency", static_cast<double>(totalLatency) / totalSatisfied);
+        LogWriter::pushValue("linearChordAverageHops", metrics.get("hops") / totalSatisfied);
+        LogWriter::pushValue("linearChordAverageLatency", metrics.get("latency") / totalSatisfied);
     }
-    LogWriter::pushValue("linearChordRequestsSatisfied", static_cast<double>(totalSatisfied));
+    LogWriter::pushValue("linearChordRequestsSatisfied", totalSatisfied);
 }
 
 } // namespace quantas
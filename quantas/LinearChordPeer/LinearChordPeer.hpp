@@ -11,6 +11,7 @@ You should have received a copy of the GNU General Public License along with QUA
 #define LINEARCHORDPEER_HPP
 
 #include <set>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -26,7 +27,11 @@ public:
 
     void initParameters(const std::vector<Peer*>& peers, json parameters) override;
     void performComputation() override;
+    void initPeer(const json& parameters) override;
     void endOfRound(std::vector<Peer*>& peers) override;
+    bool reducesMetrics() const override { return true; }
+    void collectMetrics(MetricReducer& metrics) override;
+    void reportMetrics(const MetricReducer& metrics, std::vector<Peer*>& peers) override;
 
 private:
     struct FingerEntry {
@@ -41,13 +46,14 @@ private:
     void submitLookup(int transactionId);
     json makeLookupTemplate(interfaceId target, int transactionId) const;
     interfaceId pickRandomTarget() const;
-    interfaceId selectFinger(interfaceId target, const std::set<interfaceId>& neighborSet) const;
-    interfaceId chooseClockwiseNeighbor(interfaceId target, const std::set<interfaceId>& neighborSet) const;
-    void dispatchLookup(json msg, interfaceId nextHop, const std::set<interfaceId>& neighborSet);
+    interfaceId selectFinger(interfaceId target, NeighborView neighborSet) const;
+    interfaceId chooseClockwiseNeighbor(interfaceId target, NeighborView neighborSet) const;
+    void dispatchLookup(json msg, interfaceId nextHop, NeighborView neighborSet);
     void buildFingerTable();
 
-    std::vector<interfaceId> _ringOrder;
-    std::unordered_map<interfaceId, size_t> _indexById;
+    // ring order and position of every peer, built once in initParameters and shared
+    std::shared_ptr<const std::vector<interfaceId>> _ringOrder = std::make_shared<const std::vector<interfaceId>>();
+    std::shared_ptr<const std::unordered_map<interfaceId, size_t>> _indexById = std::make_shared<const std::unordered_map<interfaceId, size_t>>();
     std::vector<FingerEntry> _fingers;
     size_t _selfIndex = 0;
     bool _initialized = false;
@@ -56,7 +62,9 @@ private:
     int _totalHops = 0;
     int _totalLatency = 0;
 
-    static int s_nextTransactionId;
+    // id of the next lookup endOfRound starts: only the first peer's is used, so it
+    // starts over with every test
+    int _nextTransactionId = 1;
 };
 
 }
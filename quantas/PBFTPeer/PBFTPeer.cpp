@@ -12,15 +12,39 @@ You should have received a copy of the GNU General Public License along with QUA
 #include <sstream>
 #include "PBFTPeer.hpp"
 #include "../Common/equivocateFault.hpp"
+#include "../Common/MessageTypes.hpp"
 
 namespace quantas {
 
+// ids of the "type" and "MessageType" names (see MessageTypes)
+static const int s_request = MessageTypes::intern("Request");
+static const int s_consensus = MessageTypes::intern("Consensus");
+static const int s_prePrepare = MessageTypes::intern("pre-prepare");
+static const int s_prepare = MessageTypes::intern("prepare");
+static const int s_commit = MessageTypes::intern("commit");
+static const int s_checkpoint = MessageTypes::intern("checkpoint");
+static const int s_viewChange = MessageTypes::intern("viewChange");
+static const int s_newView = MessageTypes::intern("newView");
+
 static bool registerPBFT = [](){
 	PeerRegistry::registerPeerType("PBFTPeer", 
 		[](interfaceId pubId){ return new PBFTPeer(new NetworkInterfaceAbstract(pubId)); });
 	return true;
 }();
 
+// prepare and commit, the two messages every replica multicasts for every request, as a
+// typed message (see TypedPayload). Carries the digest of the proposal instead of the
+// proposal itself, which is all countPrepares and countCommits look at.
+struct PBFTVote {
+    int consensusId = 0;
+    bool commit = false;        // a commit, or else a prepare
+    int seqNum = 0;
+    int view = 0;               // view of the pre-prepare voted on
+    int proposalView = 0;       // view of its proposal
+    std::string digest;         // digestOf its request
+    interfaceId from = NO_PEER_ID;
+};
+
 class PBFTConsensus : public Consensus {
 public:
     PBFTConsensus(Committee* committee);
@@ -36,8 +60,12 @@ public:
     const int WINDOW = 128; // or a parameter for watermarks
     int lastStableCheckpoint = 0;
     int viewChangeAnchorSeq = 0;  // seq key to anchor VC/NV
-    // seqNum, view
-    map<int, map<int, multimap<string, json>>> _receivedMessages;
+    // seqNum, view, MessageType id
+    map<int, map<int, multimap<int, json>>> _receivedMessages;
+    // seqNum, view: the prepares and commits that arrived typed ("typedMessages")
+    map<int, map<int, vector<PBFTVote>>> _votes;
+    // send our own prepares and commits typed
+    bool typedVotes = false;
 
     void submitRequest(Peer* peer) {
         json msg = {
@@ -54,6 +82,7 @@ public:
     }
 
     void sendCheckpoint(Peer* peer);
+    void sendVote(Peer* peer, bool commit, const json& pp, const std::string& digest);
     void maybeStableCheckpoint(Peer* peer);
     void requestViewChange(Peer* peer);
 
@@ -87,7 +116,7 @@ public:
 
     bool hasPrePrepare(int v, int n, const std::string& d) {
         auto &mm = _receivedMessages[n][v];
-        auto range = mm.equal_range("pre-prepare");
+        auto range = mm.equal_range(s_prePrepare);
         for (auto it=range.first; it!=range.second; ++it) {
             const auto& m = it->second;
             if (m.contains("proposal") &&
@@ -101,10 +130,23 @@ public:
         return false;
     }
 
+    // adds the senders of the typed votes of a kind in v,n for digest d
+    void voters(int v, int n, const std::string& d, bool commit, std::set<interfaceId>& senders) const {
+        auto seq = _votes.find(n);
+        if (seq == _votes.end()) return;
+        auto votes = seq->second.find(v);
+        if (votes == seq->second.end()) return;
+        for (const auto& vote : votes->second) {
+            if (vote.commit != commit || vote.proposalView != v || vote.digest != d) continue;
+            senders.insert(vote.from);
+        }
+    }
+
     int countPrepares(int v, int n, const std::string& d) {
         auto &mm = _receivedMessages[n][v];
-        auto range = mm.equal_range("prepare");
+        auto range = mm.equal_range(s_prepare);
         std::set<interfaceId> senders;
+        voters(v, n, d, false, senders);
         for (auto it=range.first; it!=range.second; ++it) {
             const auto& m = it->second;
             if (!m.contains("proposal")) continue;
@@ -122,8 +164,9 @@ public:
 
     int countCommits(int v, int n, const std::string& d, std::set<interfaceId>* who=nullptr) {
         auto &mm = _receivedMessages[n][v];
-        auto range = mm.equal_range("commit");
+        auto range = mm.equal_range(s_commit);
         std::set<interfaceId> senders;
+        voters(v, n, d, true, senders);
         for (auto it=range.first; it!=range.second; ++it) {
             const auto& m = it->second;
             if (!m.contains("proposal")) continue;
@@ -154,7 +197,7 @@ public:
     bool stableCheckpointReady(int seq, std::string* dig=nullptr) {
         if (seq % checkpointInterval != 0) return false;
         auto &mm = _receivedMessages[seq][view];
-        auto range = mm.equal_range("checkpoint");
+        auto range = mm.equal_range(s_checkpoint);
         std::map<std::string,int> tally;
         for (auto it=range.first; it!=range.second; ++it) {
             auto d = it->second.value("digest","__");
@@ -182,7 +225,7 @@ void PBFTConsensus::sendCheckpoint(Peer* peer) {
         {"view", view}
     };
     peer->multicast(msg, getMembers());
-    _receivedMessages[seqNum][view].insert({ "checkpoint", msg});
+    _receivedMessages[seqNum][view].insert({s_checkpoint, msg});
 }
 
 // Once enough matching checkpoints arrive, advance the stable checkpoint
@@ -203,6 +246,21 @@ void PBFTConsensus::maybeStableCheckpoint(Peer* peer) {
         if (it->first < lowWaterMark) it = _receivedMessages.erase(it);
         else ++it;
     }
+    _votes.erase(_votes.begin(), _votes.lower_bound(lowWaterMark));
+}
+
+// Prepare or commit the pre-prepare pp as a typed vote
+void PBFTConsensus::sendVote(Peer* peer, bool commit, const json& pp, const std::string& digest) {
+    PBFTVote vote;
+    vote.consensusId = getId();
+    vote.commit = commit;
+    vote.seqNum = pp["seqNum"].get<int>();
+    vote.view = pp["view"].get<int>();
+    vote.proposalView = pp["proposal"]["view"].get<int>();
+    vote.digest = digest;
+    vote.from = peer->publicId();
+    _votes[vote.seqNum][vote.view].push_back(vote);
+    peer->multicastTyped(std::move(vote), getMembers());
 }
 
 
@@ -258,9 +316,15 @@ public:
 
 void PBFTPeer::performComputation() {
 
-    while (!inStreamEmpty()) {
-        Packet packet = popInStream();
-        json msg = packet.getMessage();
+    for (Packet& packet : drainInStream()) {
+        if (const PBFTVote* vote = packet.as<PBFTVote>()) {
+            auto it = consensuses.find(vote->consensusId);
+            auto* target = it != consensuses.end() ? dynamic_cast<PBFTConsensus*>(it->second) : nullptr;
+            if (!target) { std::cout << "message lost" << std::endl; continue; }
+            target->_votes[vote->seqNum][vote->view].push_back(*vote);
+            continue;
+        }
+        json msg = packet.takeMessage();
         
         if (!msg.contains("type")) {
             std::cout << "Message requires a type" << std::endl;
@@ -270,14 +334,15 @@ void PBFTPeer::performComputation() {
             std::cout << "Message requires a consensusId" << std::endl;
             continue;
         }
-        if (msg["type"] == "Request") {
+        const int msgType = MessageTypes::find(msg, "type");
+        if (msgType == s_request) {
             int targetId = msg["consensusId"];
             auto it = consensuses.find(targetId);
             if (it != consensuses.end()) {
                 Consensus* target = it->second;
-                target->_unhandledRequests.insert({RoundManager::currentRound(), msg});
+                target->_unhandledRequests.insert({RoundManager::currentRound(), std::move(msg)});
             }
-        } else if (msg["type"] == "Consensus") {
+        } else if (msgType == s_consensus) {
             int targetId = msg["consensusId"];
             auto it = consensuses.find(targetId);
             if (it != consensuses.end()) {
@@ -295,11 +360,11 @@ void PBFTPeer::performComputation() {
                     std::cout << "Message requires a  a MessageType" << std::endl;
                     continue;
                 }
-                string type = msg["MessageType"];
+                const int type = MessageTypes::find(msg, "MessageType");
                 Consensus* base = it->second;
                 auto* target = dynamic_cast<PBFTConsensus*>(base);
                 if (!target) { std::cout << "message lost" << std::endl; continue; }
-                target->_receivedMessages[seq][view].insert({type, msg});
+                target->_receivedMessages[seq][view].insert({type, std::move(msg)});
                 // std::cout << publicId() << " receive " << type << " in round " << RoundManager::currentRound() << "\n\n";
             } else {
                 std::cout << "message lost" << std::endl;
@@ -335,7 +400,7 @@ void PBFTConsensus::requestViewChange(Peer* peer) {
         // Find highest digest prepared in oldView
         // iterate pre-prepare messages from oldView
         auto &mm = _receivedMessages[s][oldView];
-        auto ppr = mm.equal_range("pre-prepare");
+        auto ppr = mm.equal_range(s_prePrepare);
         for (auto it=ppr.first; it!=ppr.second; ++it) {
             const auto& pp = it->second;
             if ((int)pp["view"]!=oldView) continue;
@@ -359,7 +424,7 @@ void PBFTConsensus::requestViewChange(Peer* peer) {
         {"from_id", peer->publicId()}
     };
     peer->multicast(vc, getMembers());
-    _receivedMessages[viewChangeAnchorSeq][oldView].insert({"viewChange", vc});
+    _receivedMessages[viewChangeAnchorSeq][oldView].insert({s_viewChange, vc});
     
     // Update view change timer since we have requested to move to the next view
     viewChangeTimer = RoundManager::currentRound() + viewChangeDelay;
@@ -406,7 +471,7 @@ void PBFTPrePreparePhase::runPhase(Consensus* con, Peer* peer) {
         };
         
         peer->multicast(msg, c->getMembers());
-        c->_receivedMessages[n][c->view].insert({"pre-prepare", msg});
+        c->_receivedMessages[n][c->view].insert({s_prePrepare, msg});
 
         changePhase(c, PBFTPreparePhase::instance());
         // no need to run phase as it was just started
@@ -416,7 +481,7 @@ void PBFTPrePreparePhase::runPhase(Consensus* con, Peer* peer) {
         }
         int n = c->nextSeq();
         auto &mm = c->_receivedMessages[n][c->view];
-        auto range = mm.equal_range("pre-prepare");
+        auto range = mm.equal_range(s_prePrepare);
         json pp;
 
         for (auto it=range.first; it!=range.second; ++it) {
@@ -431,11 +496,15 @@ void PBFTPrePreparePhase::runPhase(Consensus* con, Peer* peer) {
         if (pp.empty()) return;
 
         // Send PREPARE matching pp
-        json prep = pp; 
-        prep["MessageType"]="prepare";
-        prep["from_id"]=peer->publicId();
-        peer->multicast(prep, c->getMembers());
-        c->_receivedMessages[n][c->view].insert({"prepare", prep});
+        if (c->typedVotes) {
+            c->sendVote(peer, false, pp, c->digestOf(pp["proposal"]["Request"]));
+        } else {
+            json prep = pp;
+            prep["MessageType"]="prepare";
+            prep["from_id"]=peer->publicId();
+            peer->multicast(prep, c->getMembers());
+            c->_receivedMessages[n][c->view].insert({s_prepare, prep});
+        }
 
         changePhase(c, PBFTPreparePhase::instance());
         c->runPhase(peer);
@@ -455,7 +524,7 @@ void PBFTPreparePhase::runPhase(Consensus* con, Peer* peer) {
     int n = c->nextSeq();
     // Find the pre-prepare digest we’re tracking
     auto &mm = c->_receivedMessages[n][c->view];
-    auto ppRange = mm.equal_range("pre-prepare");
+    auto ppRange = mm.equal_range(s_prePrepare);
     for (auto it=ppRange.first; it!=ppRange.second; ++it) {
         const auto& pp = it->second;
         if ((int)pp["view"]!=c->view) continue;
@@ -466,11 +535,15 @@ void PBFTPreparePhase::runPhase(Consensus* con, Peer* peer) {
         if (!c->isPrepared(c->view, n, d)) continue;
 
         // Prepared → send COMMIT
-        json commit = pp;
-        commit["MessageType"]="commit";
-        commit["from_id"]=peer->publicId();
-        peer->multicast(commit, c->getMembers());
-        c->_receivedMessages[n][c->view].insert({"commit", commit});
+        if (c->typedVotes) {
+            c->sendVote(peer, true, pp, d);
+        } else {
+            json commit = pp;
+            commit["MessageType"]="commit";
+            commit["from_id"]=peer->publicId();
+            peer->multicast(commit, c->getMembers());
+            c->_receivedMessages[n][c->view].insert({s_commit, commit});
+        }
 
         changePhase(c, PBFTCommitPhase::instance());
         c->runPhase(peer);
@@ -490,7 +563,7 @@ void PBFTCommitPhase::runPhase(Consensus* con, Peer* peer) {
 
     int n = c->nextSeq();
     auto &mm = c->_receivedMessages[n][c->view];
-    auto ppRange = mm.equal_range("pre-prepare");
+    auto ppRange = mm.equal_range(s_prePrepare);
     for (auto it=ppRange.first; it!=ppRange.second; ++it) {
         const auto& pp = it->second;
         if ((int)pp["view"]!=c->view) continue;
@@ -532,7 +605,7 @@ void PBFTViewChangePhase::runPhase(Consensus* con, Peer* peer) {
     // Count unique senders of viewChange(oldView → c->view)
     std::set<interfaceId> vcSenders;
     auto &mm = c->_receivedMessages[c->viewChangeAnchorSeq][c->view-1];
-    auto r = mm.equal_range("viewChange");
+    auto r = mm.equal_range(s_viewChange);
     for (auto it=r.first; it!=r.second; ++it) {
         const auto& m = it->second;
         if ((int)m["newView"]==c->view) vcSenders.insert(m["from_id"].get<interfaceId>());
@@ -542,7 +615,7 @@ void PBFTViewChangePhase::runPhase(Consensus* con, Peer* peer) {
     if (peer->publicId() == c->leaderFor(c->view)) {
         std::vector<json> prepared;
         auto &mmOld = c->_receivedMessages[c->viewChangeAnchorSeq][c->view-1];
-        auto r = mmOld.equal_range("viewChange");
+        auto r = mmOld.equal_range(s_viewChange);
         for (int n = c->lastStableCheckpoint + 1; n <= c->highWaterMark; ++n) {
             const json* best = nullptr; int bestV = -1;
             for (auto it=r.first; it!=r.second; ++it) {
@@ -570,7 +643,7 @@ void PBFTViewChangePhase::runPhase(Consensus* con, Peer* peer) {
         };
 
         peer->multicast(nv, c->getMembers());
-        c->_receivedMessages[c->viewChangeAnchorSeq][c->view].insert({"newView", nv});
+        c->_receivedMessages[c->viewChangeAnchorSeq][c->view].insert({s_newView, nv});
     }
 
     Phase* np = PBFTNewViewPhase::instance();
@@ -593,7 +666,7 @@ void PBFTNewViewPhase::runPhase(Consensus* con, Peer* peer) {
     json nv;
     {
         auto &mm = c->_receivedMessages[c->viewChangeAnchorSeq][c->view];
-        auto r = mm.equal_range("newView");
+        auto r = mm.equal_range(s_newView);
         for (auto it=r.first; it!=r.second; ++it) {
             const auto& m = it->second;
             if (m["from_id"]==c->leaderFor(c->view) && (int)m["view"]==c->view) { nv=m; break; }
@@ -604,7 +677,7 @@ void PBFTNewViewPhase::runPhase(Consensus* con, Peer* peer) {
     {
         std::set<interfaceId> vcSenders;
         auto &mm2 = c->_receivedMessages[c->viewChangeAnchorSeq][c->view-1];
-        auto r2 = mm2.equal_range("viewChange");
+        auto r2 = mm2.equal_range(s_viewChange);
         for (auto it=r2.first; it!=r2.second; ++it) {
             const auto& m = it->second;
             if ((int)m["newView"]==c->view) vcSenders.insert(m["from_id"].get<interfaceId>());
@@ -631,7 +704,7 @@ void PBFTNewViewPhase::runPhase(Consensus* con, Peer* peer) {
             {"from_id", peer->publicId()}          // new leader
         };
         peer->multicast(p, c->getMembers());
-        c->_receivedMessages[p["seqNum"].get<int>()][c->view].insert({"pre-prepare", p});
+        c->_receivedMessages[p["seqNum"].get<int>()][c->view].insert({s_prePrepare, p});
     }
     // Update view change timer since we have made it to the next view
     c->viewChangeTimer = RoundManager::currentRound() + c->viewChangeDelay;
@@ -678,41 +751,46 @@ void PBFTPeer::initParameters(const std::vector<Peer*>& _peers, json parameters)
         peers[i]->faultManager.addFault(new EquivocateFault(A,B,types));
     }
 
+    // prepares and commits go out typed unless a fault has to rewrite them
+    const bool typedMessages = parameters.value("typedMessages", false);
+
     // Assign a PBFTConsensus instance using this committee to each peer
     for (auto p : peers) {
         PBFTConsensus* pbft = new PBFTConsensus(new Committee(*committeePtr));
+        pbft->typedVotes = typedMessages && p->sendsTyped() && !p->faultsOnSend();
         p->consensuses[committeeId] = pbft;
 	}
     delete committeePtr;
 }
 
-void PBFTPeer::endOfRound(vector<Peer*>& _peers) {
-	const vector<PBFTPeer*> peers = reinterpret_cast<vector<PBFTPeer*> const&>(_peers);
+void PBFTPeer::collectMetrics(MetricReducer& metrics) {
     double length = 0;
     double latency = 0;
     double faultyConfirmed = 0;
-    int count = 0;
-    for (auto& p : peers) {
-        for (auto& consensus : p->consensuses) {
-            length += consensus.second->_confirmedTrans.size();
-            latency += consensus.second->_latency;
-            for (auto& trans : consensus.second->_confirmedTrans) {
-                if (trans.contains("fault_flip") && trans["fault_flip"] == true) {
-                    ++faultyConfirmed;
-                }
+    for (auto& consensus : consensuses) {
+        length += consensus.second->_confirmedTrans.size();
+        latency += consensus.second->_latency;
+        for (auto& trans : consensus.second->_confirmedTrans) {
+            if (trans.contains("fault_flip") && trans["fault_flip"] == true) {
+                ++faultyConfirmed;
             }
         }
     }
+    metrics.sum("length", length);
+    metrics.sum("latency", latency);
+    metrics.sum("faultyConfirmed", faultyConfirmed);
+}
 
+void PBFTPeer::reportMetrics(const MetricReducer& metrics, vector<Peer*>& _peers) {
+    const double length = metrics.get("length");
     if (length > 0) {
-        LogWriter::pushValue("latency", latency / length);
-        LogWriter::pushValue("faultyConfirmed", faultyConfirmed / length);
+        LogWriter::pushValue("latency", metrics.get("latency") / length);
+        LogWriter::pushValue("faultyConfirmed", metrics.get("faultyConfirmed") / length);
     } else {
         LogWriter::pushValue("latency", 0.0);
         LogWriter::pushValue("faultyConfirmed", 0.0);
     }
-	LogWriter::pushValue("throughput", length / peers.size());
-    
+	LogWriter::pushValue("throughput", length / _peers.size());
 }
 
 }
@@ -32,8 +32,10 @@ namespace quantas{
         // initialize the configuration of the system
         void initParameters(const std::vector<Peer*>& peers, json parameters) override;
         
-        // perform any calculations needed at the end of a round such as determine throughput (only ran once, not for every peer)
-        void endOfRound(vector<Peer*>& _peers) override;
+        // end of round metrics: each peer adds its confirmed transactions, the totals are logged once
+        bool reducesMetrics() const override { return true; }
+        void collectMetrics(MetricReducer& metrics) override;
+        void reportMetrics(const MetricReducer& metrics, vector<Peer*>& _peers) override;
         
     };
 }
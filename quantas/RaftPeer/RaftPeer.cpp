@@ -26,6 +26,7 @@ If not, see <https://www.gnu.org/licenses/>.
 
 #include "../Common/Committee.hpp"
 #include "../Common/LogWriter.hpp"
+#include "../Common/MessageTypes.hpp"
 #include "../Common/Packet.hpp"
 #include "../Common/RandomUtil.hpp"
 #include "../Common/RoundManager.hpp"
@@ -86,6 +87,8 @@ public:
     void onConsensusMessage(RaftPeer* peer, const json& msg);
     void onClientRequest(RaftPeer* peer, json request);
     void tick(RaftPeer* peer);
+    // earliest round tick has something to do without a message arriving
+    size_t nextWakeRound() const;
 
     void setTimeoutSpacing(int spacing) { _timeOutSpacing = spacing; }
     void setTimeoutRandom(int random) { _timeOutRandom = random; }
@@ -93,6 +96,9 @@ public:
     int leaderChanges() const { return _leaderChanges; }
 
 private:
+    // the handle* methods by "MessageType"
+    static const MessageTable<void (RaftConsensus::*)(RaftPeer*, const json&)> s_handlers;
+
     void handleRequest(RaftPeer* peer, const json& msg);
     void handleRespond(RaftPeer* peer, const json& msg);
     void handleVote(RaftPeer* peer, const json& msg);
@@ -141,6 +147,7 @@ private:
     bool _initialSubmissionAttempted = false;
 
     int _submitRate = 20;
+    size_t _nextSubmitRound = NO_ROUND;
     int _nextClientRequestId = 0;
 };
 
@@ -152,18 +159,17 @@ RaftConsensus::RaftConsensus(Committee* committee) {
     resetTimer();
 }
 
+const MessageTable<void (RaftConsensus::*)(RaftPeer*, const json&)> RaftConsensus::s_handlers = {
+    {"request", &RaftConsensus::handleRequest},
+    {"respondRequest", &RaftConsensus::handleRespond},
+    {"vote", &RaftConsensus::handleVote},
+    {"elect", &RaftConsensus::handleElect},
+    {"commit", &RaftConsensus::handleCommit}
+};
+
 void RaftConsensus::onConsensusMessage(RaftPeer* peer, const json& msg) {
-    const string messageType = msg.value("MessageType", string());
-    if (messageType == "request") {
-        handleRequest(peer, msg);
-    } else if (messageType == "respondRequest") {
-        handleRespond(peer, msg);
-    } else if (messageType == "vote") {
-        handleVote(peer, msg);
-    } else if (messageType == "elect") {
-        handleElect(peer, msg);
-    } else if (messageType == "commit") {
-        handleCommit(peer, msg);
+    if (auto handler = s_handlers.find(msg, "MessageType")) {
+        (this->*handler)(peer, msg);
     }
 }
 
@@ -192,6 +198,17 @@ void RaftConsensus::tick(RaftPeer* peer) {
     // tryStartReplication(peer);
 }
 
+size_t RaftConsensus::nextWakeRound() const {
+    // deferred requests are forwarded as soon as a leader is learned, which only
+    // happens on a message or an election, so only the timer and submissions count
+    size_t wake = static_cast<size_t>(std::max(_timeOutRound, 0));
+    if (_submitRate > 0) {
+        const size_t submit = (_nextSubmitRound == NO_ROUND) ? RoundManager::currentRound() + 1 : _nextSubmitRound;
+        wake = std::min(wake, submit);
+    }
+    return wake;
+}
+
 void RaftConsensus::handleRequest(RaftPeer* peer, const json& msg) {
     const int termNum = msg.value("termNum", -1);
     const interfaceId sender = msg.value("from_id", NO_PEER_ID);
@@ -334,9 +351,16 @@ void RaftConsensus::maybeGenerateClientRequest(RaftPeer* peer) {
     if (_submitRate <= 0) {
         return;
     }
-    if (randMod(_submitRate) != 0) {
+    // equivalent to a 1 in _submitRate roll every round, but drawn as the number of
+    // rounds until the next success; a round missed while crashed is redrawn
+    const size_t now = RoundManager::currentRound();
+    if (_nextSubmitRound == NO_ROUND || _nextSubmitRound < now) {
+        _nextSubmitRound = now + geometricInt(1.0 / _submitRate);
+    }
+    if (_nextSubmitRound > now) {
         return;
     }
+    _nextSubmitRound = now + 1 + geometricInt(1.0 / _submitRate);
     json request = {
         {"submitterId", peer->publicId()},
         {"clientSeq", _nextClientRequestId++},
@@ -582,6 +606,10 @@ static bool registerRaft = []() {
     return true;
 }();
 
+// the "type" of client requests and of messages between replicas
+static const int s_request = MessageTypes::intern("Request");
+static const int s_consensus = MessageTypes::intern("Consensus");
+
 RaftPeer::~RaftPeer() = default;
 
 RaftPeer::RaftPeer(const RaftPeer& rhs) : ConsensusPeer(rhs) {}
@@ -593,29 +621,49 @@ void RaftPeer::maybeCrash() {
         return;
     }
 
-    if (trueWithProbability(_crashOdds)) {
-        setCrashRecoveryRound(RoundManager::currentRound() + _crashRecoveryDelay);
+    const size_t now = RoundManager::currentRound();
+    if (_nextCrashRound == NO_ROUND || _nextCrashRound < now) {
+        _nextCrashRound = now + geometricInt(_crashOdds);
+    }
+    if (_nextCrashRound == now) {
+        setCrashRecoveryRound(now + _crashRecoveryDelay);
+        _nextCrashRound = NO_ROUND;
     }
 }
 
+size_t RaftPeer::nextWakeRound() {
+    if (isCrashed()) {
+        return crashRecoveryRound();
+    }
+    size_t wake = NO_ROUND;
+    if (_crashOdds > 0.0 && _crashRecoveryDelay != 0) {
+        wake = (_nextCrashRound == NO_ROUND) ? RoundManager::currentRound() + 1 : _nextCrashRound;
+    }
+    for (auto& entry : consensuses) {
+        if (auto* raft = dynamic_cast<RaftConsensus*>(entry.second)) {
+            wake = std::min(wake, raft->nextWakeRound());
+        }
+    }
+    return wake;
+}
+
 void RaftPeer::performComputation() {
     maybeCrash();
     if (isCrashed()) {
         return;
     }
 
-    while (!inStreamEmpty()) {
-        Packet packet = popInStream();
-        json msg = packet.getMessage();
+    for (Packet& packet : drainInStream()) {
+        json msg = packet.takeMessage();
 
-        if (!msg.contains("type")) {
+        const int msgType = MessageTypes::find(msg, "type");
+        if (msgType == NO_MESSAGE_TYPE) {
             continue;
         }
 
-        const string msgType = msg["type"];
         const int consensusId = msg.value("consensusId", 0);
 
-        if (msgType == "Request") {
+        if (msgType == s_request) {
             auto it = consensuses.find(consensusId);
             if (it != consensuses.end()) {
                 if (auto* raft = dynamic_cast<RaftConsensus*>(it->second)) {
@@ -624,7 +672,7 @@ void RaftPeer::performComputation() {
                     it->second->_unhandledRequests.insert({RoundManager::currentRound(), msg});
                 }
             }
-        } else if (msgType == "Consensus") {
+        } else if (msgType == s_consensus) {
             auto it = consensuses.find(consensusId);
             if (it == consensuses.end()) {
                 continue;
@@ -691,25 +739,20 @@ void RaftPeer::initParameters(const std::vector<Peer*>& peers, json parameters)
     }
 }
 
-void RaftPeer::endOfRound(std::vector<Peer*>& peers) {
-    double totalConfirmed = 0.0;
-    double totalLatency = 0.0;
-    int totalLeaderChanges = 0;
-
-    for (Peer* base : peers) {
-        if (auto* raftPeer = dynamic_cast<RaftPeer*>(base)) {
-            for (auto& entry : raftPeer->consensuses) {
-                if (auto* consensus = dynamic_cast<RaftConsensus*>(entry.second)) {
-                    totalConfirmed += static_cast<double>(consensus->_confirmedTrans.size());
-                    totalLatency += static_cast<double>(consensus->_latency);
-                    totalLeaderChanges += consensus->leaderChanges();
-                }
-            }
+void RaftPeer::collectMetrics(MetricReducer& metrics) {
+    for (auto& entry : consensuses) {
+        if (auto* consensus = dynamic_cast<RaftConsensus*>(entry.second)) {
+            metrics.sum("confirmed", static_cast<double>(consensus->_confirmedTrans.size()));
+            metrics.sum("latency", static_cast<double>(consensus->_latency));
+            metrics.sum("leaderChanges", consensus->leaderChanges());
         }
     }
+}
 
+void RaftPeer::reportMetrics(const MetricReducer& metrics, std::vector<Peer*>& peers) {
+    const double totalConfirmed = metrics.get("confirmed");
     if (totalConfirmed > 0.0) {
-        LogWriter::pushValue("latency", totalLatency / totalConfirmed);
+        LogWriter::pushValue("latency", metrics.get("latency") / totalConfirmed);
     } else {
         LogWriter::pushValue("latency", 0.0);
     }
@@ -720,7 +763,7 @@ void RaftPeer::endOfRound(std::vector<Peer*>& peers) {
         LogWriter::pushValue("throughput", 0.0);
     }
 
-    LogWriter::pushValue("leaderChanges", totalLeaderChanges);
+    LogWriter::pushValue("leaderChanges", static_cast<int>(metrics.get("leaderChanges")));
 }
 
 } // namespace quantas
@@ -22,7 +22,10 @@ public:
 
     void performComputation() override;
     void initParameters(const std::vector<Peer*>& peers, json parameters) override;
-    void endOfRound(std::vector<Peer*>& peers) override;
+    bool reducesMetrics() const override { return true; }
+    void collectMetrics(MetricReducer& metrics) override;
+    void reportMetrics(const MetricReducer& metrics, std::vector<Peer*>& peers) override;
+    size_t nextWakeRound() override;
 
     double crashOdds() const { return _crashOdds; }
     void setCrashOdds(double odds) { _crashOdds = odds; }
@@ -32,6 +35,8 @@ private:
 
     double _crashOdds = 0.0;
     size_t _crashRecoveryDelay = 0;
+    // round of the next crash, drawn geometrically rather than rolled every round
+    size_t _nextCrashRound = NO_ROUND;
 };
 
 } // namespace quantas
@@ -52,7 +52,7 @@ void SyncPeer::performComputation() {
         while (!inStreamEmpty()) {
             Packet packet = popInStream();
             interfaceId source = packet.sourceId();
-            json Message = packet.getMessage();
+            json Message = packet.takeMessage();
             if (Message["action"] == "ack" &&
                 neighbors().find(source) != neighbors().end() &&
                 Message["round"] == SentRound) {
@@ -59,7 +59,7 @@ void SyncPeerB::performComputation() {
         while (!inStreamEmpty()) {
             Packet packet = popInStream();
             interfaceId source = packet.sourceId();
-            json Message = packet.getMessage();
+            json Message = packet.takeMessage();
             if (Message["action"] == "init") {
                 // This case should only happen in the first round, and is used
                 // to initialize the children vector for each node
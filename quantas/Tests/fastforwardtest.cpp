@@ -0,0 +1,34 @@
+// Checks that fast-forward gives the results of running round by round: runs of
+// FastForwardInput.json come in pairs with the same seed, one of them with
+// "fastForward": true, and their logs must match but for the skipped round count.
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "../Common/Json.hpp"
+
+using nlohmann::json;
+
+json testsOf(const std::string& logFile) {
+    std::ifstream in(logFile);
+    if (!in) {
+        std::cerr << "missing log " << logFile << std::endl;
+        std::exit(1);
+    }
+    json tests = json::parse(in)["tests"];
+    for (auto& test : tests) test.erase("skippedRounds");
+    return tests;
+}
+
+int main() {
+    int failures = 0;
+    for (const std::string peer : {"Kademlia", "Raft", "Bitcoin"}) {
+        const json everyRound = testsOf("FastForward" + peer + "EveryRound.txt");
+        const json skipped = testsOf("FastForward" + peer + "Skipped.txt");
+        if (everyRound != skipped) {
+            std::cerr << peer << ": fast-forward changed the results" << std::endl;
+            ++failures;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+// Counts heap allocations per delivered message on the abstract send/receive path:
+// a peer sends a block-sized JSON message to each of its neighbors through real
+// channels, and every neighbor receives it, drains its in stream and reads the payload.
+// The same block as a typed message (TypedPayload) is measured against the json one.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+#include <cassert>
+#include "../Common/Abstract/NetworkInterfaceAbstract.hpp"
+
+static std::atomic<size_t> allocations{0};
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+using namespace quantas;
+
+namespace {
+
+const int Neighbors = 64;
+const int Rounds = 200;
+
+json blockMessage(int round) {
+    json msg;
+    msg["type"] = "PoW";
+    msg["messageType"] = "block";
+    msg["block"]["hash"] = "block-" + std::to_string(round);
+    msg["block"]["height"] = round;
+    for (int i = 0; i < 16; ++i) {
+        msg["block"]["transactions"].push_back({{"id", i}, {"submitter", i % 7}, {"roundSubmitted", round}});
+    }
+    return msg;
+}
+
+// the typed equivalent of blockMessage
+struct Transaction {
+    int id;
+    int submitter;
+    int roundSubmitted;
+};
+struct Block {
+    std::string hash;
+    int height;
+    std::vector<Transaction> transactions;
+};
+
+Block typedBlock(int round) {
+    Block block{"block-" + std::to_string(round), round, {}};
+    for (int i = 0; i < 16; ++i) {
+        block.transactions.push_back({i, i % 7, round});
+    }
+    return block;
+}
+
+struct Network {
+    std::vector<interfaceId> ids;
+    std::unique_ptr<Channel[]> channels;
+    NetworkInterfaceAbstract sender{0, 0};
+    std::vector<std::unique_ptr<NetworkInterfaceAbstract>> receivers;
+
+    Network() : channels(new Channel[Neighbors]) {
+        json distribution = {{"type", "ONE"}};
+        for (int i = 1; i <= Neighbors; ++i) {
+            ids.push_back(i);
+            channels[i - 1].connect(i, i, 0, 0, distribution);
+            receivers.push_back(std::make_unique<NetworkInterfaceAbstract>(i, i));
+            receivers.back()->setInboundChannels({&channels[i - 1]});
+        }
+        NeighborView row(ids.data(), ids.data() + ids.size());
+        sender.setNeighbors(row);
+        sender.setOutboundChannels(row, channels.get());
+    }
+};
+
+// sends one message per round, built by make() and sent with send(), then has every
+// receiver drain its inbox with read(); returns allocations per delivered message
+template <typename Make, typename Send, typename Read>
+double run(const char* name, Make make, Send send, Read read) {
+    RoundManager::setCurrentRound(0);
+    Network net;
+    size_t delivered = 0;
+    size_t allocated = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < Rounds; ++round) {
+        RoundManager::setCurrentRound(round);
+        auto msg = make(round);
+        const size_t before = allocations.load(std::memory_order_relaxed);
+        send(net.sender, std::move(msg), net.ids);
+        RoundManager::setCurrentRound(round + 1);
+        for (auto& receiver : net.receivers) {
+            receiver->receive();
+            for (Packet& packet : receiver->drainInStream()) {
+                read(packet);
+                ++delivered;
+            }
+        }
+        allocated += allocations.load(std::memory_order_relaxed) - before;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    assert(delivered == static_cast<size_t>(Rounds) * Neighbors);
+    double perMessage = static_cast<double>(allocated) / delivered;
+    std::cout << "  " << name << ": " << perMessage << " allocations, "
+              << seconds * 1e9 / delivered << " ns per delivered message" << std::endl;
+    return perMessage;
+}
+
+} // namespace
+
+int main() {
+    RoundManager::setLastRound(Rounds + 2);
+    std::cout << "Fan-out to " << Neighbors << " neighbors, " << Rounds << " rounds" << std::endl;
+
+    auto borrow = [](Packet& packet) {
+        const json& msg = packet.getMessage();
+        assert(msg.at("block").at("transactions").size() == 16);
+    };
+    auto take = [](Packet& packet) {
+        json msg = packet.takeMessage();
+        assert(msg.at("block").at("transactions").size() == 16);
+    };
+
+    auto typedRead = [](Packet& packet) {
+        const Block* block = packet.as<Block>();
+        assert(block != nullptr && block->transactions.size() == 16);
+        (void)block;
+    };
+
+    // one unicastTo per neighbor with the same json: every packet gets its own tree
+    double perCopy = run("unicastTo each neighbor, copied", blockMessage, [](NetworkInterfaceAbstract& sender, json msg, const std::vector<interfaceId>& ids) {
+        for (interfaceId id : ids) sender.unicastTo(msg, id);
+    }, borrow);
+    // broadcast builds the payload once and the receivers read it in place
+    double perShared = run("broadcast, receivers borrow", blockMessage, [](NetworkInterfaceAbstract& sender, json msg, const std::vector<interfaceId>&) {
+        sender.broadcast(std::move(msg));
+    }, borrow);
+    // receivers that keep the message copy it, except the last one, which takes it over
+    run("broadcast, receivers take", blockMessage, [](NetworkInterfaceAbstract& sender, json msg, const std::vector<interfaceId>&) {
+        sender.broadcast(std::move(msg));
+    }, take);
+    // a typed block is one struct instead of a tree of json nodes; receivers read it in place
+    double perTyped = run("typed broadcast, receivers read", typedBlock, [](NetworkInterfaceAbstract& sender, Block msg, const std::vector<interfaceId>&) {
+        sender.broadcastTyped(TypedPayload::make(std::move(msg)));
+    }, typedRead);
+    // a typed message sent to one neighbor at a time costs no tree copy either
+    double perTypedUnicast = run("typed unicastTyped each neighbor", typedBlock, [](NetworkInterfaceAbstract& sender, Block msg, const std::vector<interfaceId>& ids) {
+        const TypedPayload payload = TypedPayload::make(std::move(msg));
+        for (interfaceId id : ids) sender.unicastTyped(payload, id);
+    }, typedRead);
+
+    assert(perShared < perCopy);
+    assert(perTypedUnicast < perCopy);
+    (void)perCopy;
+    (void)perShared;
+    (void)perTyped;
+    (void)perTypedUnicast;
+    return 0;
+}
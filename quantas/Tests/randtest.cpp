@@ -2,6 +2,7 @@
 #include <thread>
 #include <vector>
 #include <cassert>
+#include <climits>
 #include "../Common/RandomUtil.hpp"
 
 void getRandomInts(std::vector<int> &randomInts, int howMany)
@@ -46,5 +47,72 @@ int main()
         }
     }
 
+    // a stream gives the same sequence whichever thread draws from it,
+    // and streams keyed by another peer or test give different ones
+    std::vector<uint32_t> fromThread;
+    std::thread([&fromThread]() {
+        quantas::RandomStream stream(42, 0, 7, 0);
+        for (int k = 0; k < RandIntCount; k++) fromThread.push_back(stream());
+    }).join();
+    quantas::RandomStream same(42, 0, 7, 0), otherPeer(42, 0, 8, 0), otherTest(42, 1, 7, 0);
+    bool peerDiffers = false, testDiffers = false;
+    for (int k = 0; k < RandIntCount; k++)
+    {
+        assert(same() == fromThread[k]);
+        peerDiffers |= otherPeer() != fromThread[k];
+        testDiffers |= otherTest() != fromThread[k];
+    }
+    assert(peerDiffers && testDiffers);
+
+    // inside a scope the helpers draw from the scope's stream
+    quantas::RandomStream scoped(42, 0, 7, 0), direct(42, 0, 7, 0);
+    {
+        quantas::RandomStream::Scope scope(scoped);
+        assert(quantas::uniformInt(0, 1 << 16) == int(quantas::boundedInt(direct, (1 << 16) + 1)));
+    }
+
+    // a known seed gives fixed draws, whatever the standard library
+    quantas::RandomStream known(42, 0, 9, 0);
+    {
+        quantas::RandomStream::Scope scope(known);
+        const int ints[] = {59, 40, 14, 8, 83, 58};
+        for (int expected : ints) assert(quantas::uniformInt(0, 99) == expected);
+        const double reals[] = {0.84996817459205698, 0.54037999514283575, 0.47990253536928296};
+        for (double expected : reals) assert(quantas::uniformReal(0.0, 1.0) == expected);
+        assert(quantas::uniformInt(INT_MIN, INT_MAX) == 1287900002);
+    }
+
+    // the helpers stay in range and hit every value about equally often
+    quantas::RandomStream spread(42, 0, 9, 1);
+    {
+        quantas::RandomStream::Scope scope(spread);
+        const int Draws = 100000, Buckets = 10;
+        std::vector<int> ints(Buckets), reals(Buckets);
+        for (int k = 0; k < Draws; k++)
+        {
+            const int hi = k % 7 == 0 ? INT_MAX : k;
+            const int value = quantas::uniformInt(-k, hi);
+            assert(value >= -k && value <= hi);
+            const double real = quantas::uniformReal(-1.0, 1.0);
+            assert(real >= -1.0 && real < 1.0);
+            ints[quantas::uniformInt(0, Buckets - 1)]++;
+            reals[int((real + 1.0) / 2.0 * Buckets)]++;
+        }
+        // each bucket expects 10000 draws, with a standard deviation under 100
+        for (int b = 0; b < Buckets; b++)
+        {
+            assert(ints[b] > 9500 && ints[b] < 10500);
+            assert(reals[b] > 9500 && reals[b] < 10500);
+        }
+    }
+
+    // batches yield the values of one call at a time
+    quantas::RandomStream batched(42, 3, 5, 1), single(42, 3, 5, 1);
+    std::vector<uint32_t> values(203);
+    batched();
+    batched.fill(values.data(), values.size());
+    single();
+    for (uint32_t value : values) assert(value == single());
+
     return 0;
 }